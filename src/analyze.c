@@ -57,6 +57,9 @@ discard_confusing_lines (struct file_data filevec[])
   /* Allocate our results.  */
   lin *p = xinmalloc (filevec[0].buffered_lines + filevec[1].buffered_lines,
 		      2 * sizeof *p);
+  advise_huge_pages (p, ((filevec[0].buffered_lines
+			  + filevec[1].buffered_lines)
+			 * 2 * sizeof *p));
   for (int f = 0; f < 2; f++)
     {
       filevec[f].undiscarded = p;  p += filevec[f].buffered_lines;
@@ -67,6 +70,7 @@ discard_confusing_lines (struct file_data filevec[])
      that fall in equivalence class I.  */
 
   p = xicalloc (filevec[0].equiv_max, 2 * sizeof *p);
+  advise_huge_pages (p, filevec[0].equiv_max * 2 * sizeof *p);
   lin *equiv_count[2];
   equiv_count[0] = p;
   equiv_count[1] = p + filevec[0].equiv_max;
@@ -238,6 +242,671 @@ discard_confusing_lines (struct file_data filevec[])
   free (equiv_count[0]);
 }
 
+/* Compare the files of FILEVEC, which are sorted, by merging them as
+   comm does: a line that sorts before the other file's next line
+   cannot match anything there, so mark it as changed.  This takes
+   time linear in the number of lines, and yields a minimal edit
+   script if the files have no duplicate lines.  This relies on
+   equivalent lines being equal bytes, so main does not merge files
+   with options like --ignore-case that ignore some differences.  */
+
+static void
+merge_sorted_lines (struct file_data filevec[])
+{
+  lin n0 = filevec[0].buffered_lines, n1 = filevec[1].buffered_lines;
+  lin const *e0 = filevec[0].equivs, *e1 = filevec[1].equivs;
+  char const *const *l0 = filevec[0].linbuf, *const *l1 = filevec[1].linbuf;
+  bool *changed0 = filevec[0].changed, *changed1 = filevec[1].changed;
+  lin i = 0, j = 0;
+
+  while (i < n0 && j < n1)
+    {
+      if (e0[i] == e1[j])
+	i++, j++;
+      else if (compare_line_bytes (l0[i], l0[i + 1] - l0[i],
+				   l1[j], l1[j + 1] - l1[j])
+	       < 0)
+	changed0[i++] = true;
+      else
+	changed1[j++] = true;
+    }
+
+  for (; i < n0; i++)
+    changed0[i] = true;
+  for (; j < n1; j++)
+    changed1[j] = true;
+}
+
+/* With --minimal, compareseq takes time proportional to the product
+   of the number of lines and the number of differences, which is
+   quadratic when the files differ densely.  In that case, find a
+   longest common subsequence by Hirschberg's method instead, using
+   the bit-parallel algorithm of Allison and Dix, as refined by
+   Crochemore et al., to compute each row of the dynamic programming
+   table a machine word of lines at a time.  Fall back on compareseq
+   for subproblems that differ little, where it is faster.  */
+
+typedef size_t lcs_word;
+enum { LCS_WORD_BITS = SIZE_WIDTH };
+
+/* A count of a pair of adjacent lines of equivalence classes A and B,
+   in a hash table where A is -1 in unused slots.  */
+struct lcs_pair
+{
+  lin a, b;
+  lin count;
+};
+
+/* The state of a bit-parallel comparison.  */
+struct lcs
+{
+  /* The comparison context, and its vectors of equivalence classes.  */
+  struct context *ctxt;
+  lin const *xvec, *yvec;
+
+  /* The number of lines in YVEC, and of words in a mask of them.  */
+  lin ylines;
+  idx_t ywords;
+
+  /* The positions of the lines of equivalence class C in YVEC are
+     YPOS[YSTART[C]] through YPOS[YSTART[C + 1] - 1], in increasing
+     order.  */
+  lin *ystart;
+  lin *ypos;
+
+  /* If equivalence class C occurs often in YVEC, FMASK[C] is the
+     mask of its positions, and RMASK[C] is the mask of its positions
+     in the reverse of YVEC.  Otherwise both are null.  */
+  lcs_word **fmask;
+  lcs_word **rmask;
+
+  /* Scratch space: a count for each equivalence class, initially
+     zero; a hash table of pairs, initially unused, of which
+     PAIRS_MASK + 1 is the size, and the indexes of its slots in use;
+     two masks; and two rows of the table.  */
+  lin *count;
+  struct lcs_pair *pairs;
+  idx_t pairs_mask;
+  idx_t *pairs_used;
+  lcs_word *vec;
+  lcs_word *match;
+  lin *frow;
+  lin *brow;
+};
+
+/* Set bit K of MASK.  */
+
+static void
+lcs_set_bit (lcs_word *mask, lin k)
+{
+  mask[k / LCS_WORD_BITS] |= (lcs_word) 1 << (k % LCS_WORD_BITS);
+}
+
+/* Add DELTA to the count of the pair of adjacent lines of classes A
+   and B, and if its slot was unused, append the slot to those in use,
+   whose number is *NUSED.  */
+
+static void
+lcs_count_pair (struct lcs *l, lin a, lin b, lin delta, idx_t *nused)
+{
+  idx_t i = ((size_t) a * 2654435761u + b) & l->pairs_mask;
+  for (; 0 <= l->pairs[i].a; i = (i + 1) & l->pairs_mask)
+    if (l->pairs[i].a == a && l->pairs[i].b == b)
+      {
+	l->pairs[i].count += delta;
+	return;
+      }
+  l->pairs[i] = (struct lcs_pair) { .a = a, .b = b, .count = delta };
+  l->pairs_used[(*nused)++] = i;
+}
+
+/* Return a lower bound on the number of lines that must be inserted
+   or deleted to turn lines XOFF up to XLIM into lines YOFF up to
+   YLIM.  One bound is the number of lines of each equivalence class
+   that are not matched by a line of the same class on the other side.
+   Another is a third of the number of pairs of adjacent lines not so
+   matched, as inserting or deleting a line changes at most three
+   pairs.  The latter is better when lines are moved around.  */
+
+static lin
+lcs_lower_bound (struct lcs *l, lin xoff, lin xlim, lin yoff, lin ylim)
+{
+  lin *count = l->count;
+  for (lin i = xoff; i < xlim; i++)
+    count[l->xvec[i]]++;
+  for (lin j = yoff; j < ylim; j++)
+    count[l->yvec[j]]--;
+
+  lin bound = 0;
+  for (lin i = xoff; i < xlim; i++)
+    {
+      bound += count[l->xvec[i]] < 0 ? - count[l->xvec[i]] : count[l->xvec[i]];
+      count[l->xvec[i]] = 0;
+    }
+  for (lin j = yoff; j < ylim; j++)
+    {
+      bound += count[l->yvec[j]] < 0 ? - count[l->yvec[j]] : count[l->yvec[j]];
+      count[l->yvec[j]] = 0;
+    }
+
+  idx_t nused = 0;
+  for (lin i = xoff + 1; i < xlim; i++)
+    lcs_count_pair (l, l->xvec[i - 1], l->xvec[i], 1, &nused);
+  for (lin j = yoff + 1; j < ylim; j++)
+    lcs_count_pair (l, l->yvec[j - 1], l->yvec[j], -1, &nused);
+  lin pair_bound = 0;
+  for (idx_t u = 0; u < nused; u++)
+    {
+      struct lcs_pair *p = &l->pairs[l->pairs_used[u]];
+      pair_bound += p->count < 0 ? - p->count : p->count;
+      p->a = -1;
+    }
+
+  return MAX (bound, pair_bound / 3);
+}
+
+/* Set the WORDS words of MASK to the mask of the lines of equivalence
+   class C among lines YOFF up to YLIM, in reverse order if REVERSED.  */
+
+static void
+lcs_match_mask (struct lcs const *l, lin c, lin yoff, lin ylim,
+		bool reversed, lcs_word *mask, idx_t words)
+{
+  lcs_word const *whole = (reversed ? l->rmask : l->fmask)[c];
+  if (whole)
+    {
+      lin off = reversed ? l->ylines - ylim : yoff;
+      idx_t w0 = off / LCS_WORD_BITS;
+      int shift = off % LCS_WORD_BITS;
+      for (idx_t w = 0; w < words; w++)
+	{
+	  lcs_word bits = whole[w0 + w] >> shift;
+	  if (shift && w0 + w + 1 < l->ywords)
+	    bits |= whole[w0 + w + 1] << (LCS_WORD_BITS - shift);
+	  mask[w] = bits;
+	}
+      int tail = (ylim - yoff) % LCS_WORD_BITS;
+      if (tail)
+	mask[words - 1] &= ((lcs_word) 1 << tail) - 1;
+    }
+  else
+    {
+      memset (mask, 0, words * sizeof *mask);
+      lin lo = l->ystart[c], hi = l->ystart[c + 1];
+      while (lo < hi)
+	{
+	  lin mid = lo + (hi - lo) / 2;
+	  if (l->ypos[mid] < yoff)
+	    lo = mid + 1;
+	  else
+	    hi = mid;
+	}
+      for (lin p = lo; p < l->ystart[c + 1] && l->ypos[p] < ylim; p++)
+	{
+	  lin k = reversed ? ylim - 1 - l->ypos[p] : l->ypos[p] - yoff;
+	  lcs_set_bit (mask, k);
+	}
+    }
+}
+
+/* Set ROW[K] to the length of a longest common subsequence of lines
+   XOFF up to XLIM and the first K of lines YOFF up to YLIM, or the
+   last K if REVERSED, for each K from 0 through YLIM - YOFF.  */
+
+static void
+lcs_row (struct lcs *l, lin xoff, lin xlim, lin yoff, lin ylim,
+	 bool reversed, lin *row)
+{
+  lin m = ylim - yoff;
+  idx_t words = (m + LCS_WORD_BITS - 1) / LCS_WORD_BITS;
+  lcs_word *v = l->vec, *match = l->match;
+
+  /* Each zero bit of V stands for a line of the common subsequence.  */
+  for (idx_t w = 0; w < words; w++)
+    v[w] = -1;
+
+  for (lin i = xoff; i < xlim; i++)
+    {
+      lcs_match_mask (l, l->xvec[reversed ? xlim - 1 - (i - xoff) : i],
+		      yoff, ylim, reversed, match, words);
+      lcs_word carry = 0;
+      for (idx_t w = 0; w < words; w++)
+	{
+	  lcs_word u = v[w] & match[w];
+	  lcs_word sum = v[w] + u;
+	  lcs_word c = sum < u;
+	  sum += carry;
+	  carry = c | (sum < carry);
+	  v[w] = sum | (v[w] & ~match[w]);
+	}
+    }
+
+  row[0] = 0;
+  for (lin k = 0; k < m; k++)
+    row[k + 1] = row[k] + ! ((v[k / LCS_WORD_BITS] >> (k % LCS_WORD_BITS))
+			     & 1);
+}
+
+/* Compare lines XOFF up to XLIM with lines YOFF up to YLIM, noting
+   a minimal set of insertions and deletions.  */
+
+static void
+lcs_compare (struct lcs *l, lin xoff, lin xlim, lin yoff, lin ylim)
+{
+  lin const *xv = l->xvec, *yv = l->yvec;
+  while (xoff < xlim && yoff < ylim && xv[xoff] == yv[yoff])
+    xoff++, yoff++;
+  while (xoff < xlim && yoff < ylim && xv[xlim - 1] == yv[ylim - 1])
+    xlim--, ylim--;
+
+  /* The bit-parallel method takes time proportional to the number of
+     lines of one side times the number of words of the other, for
+     two rows per level of recursion.  compareseq takes time at least
+     proportional to the square of the number of differences.  */
+  lin n = xlim - xoff, m = ylim - yoff;
+  lin words = (m + LCS_WORD_BITS - 1) / LCS_WORD_BITS;
+  lin bound = n < 2 ? 0 : lcs_lower_bound (l, xoff, xlim, yoff, ylim);
+  lin cost, bound2;
+  if (n < 2 || ckd_mul (&cost, 4 * n, words)
+      || (! ckd_mul (&bound2, bound, bound) && bound2 <= cost))
+    {
+      compareseq (xoff, xlim, yoff, ylim, true, l->ctxt);
+      return;
+    }
+
+  /* Split the lines of X in half, and split those of Y where the
+     sum of the lengths of the common subsequences of the two halves
+     is greatest.  */
+  lin xmid = xoff + n / 2;
+  lcs_row (l, xoff, xmid, yoff, ylim, false, l->frow);
+  lcs_row (l, xmid, xlim, yoff, ylim, true, l->brow);
+  lin best = -1, ymid = yoff;
+  for (lin k = 0; k <= m; k++)
+    {
+      lin len = l->frow[k] + l->brow[m - k];
+      if (best < len)
+	{
+	  best = len;
+	  ymid = yoff + k;
+	}
+    }
+
+  lcs_compare (l, xoff, xmid, yoff, ymid);
+  lcs_compare (l, xmid, xlim, ymid, ylim);
+}
+
+/* Compare lines 0 up to XLINES of CTXT->xvec with lines 0 up to
+   YLINES of CTXT->yvec, which are equivalence classes less than
+   EQUIV_MAX, noting a minimal set of insertions and deletions.  */
+
+static void
+compare_minimal (struct context *ctxt, lin xlines, lin ylines, lin equiv_max)
+{
+  struct lcs l;
+  l.ctxt = ctxt;
+  l.xvec = ctxt->xvec;
+  l.yvec = ctxt->yvec;
+  l.ylines = ylines;
+  l.ywords = (ylines + LCS_WORD_BITS - 1) / LCS_WORD_BITS;
+
+  l.ystart = xicalloc (equiv_max + 1, sizeof *l.ystart);
+  for (lin j = 0; j < ylines; j++)
+    l.ystart[l.yvec[j] + 1]++;
+  for (lin c = 0; c < equiv_max; c++)
+    l.ystart[c + 1] += l.ystart[c];
+  l.ypos = xinmalloc (ylines + 1, sizeof *l.ypos);
+  l.count = xicalloc (equiv_max, sizeof *l.count);
+  for (lin j = 0; j < ylines; j++)
+    l.ypos[l.ystart[l.yvec[j]] + l.count[l.yvec[j]]++] = j;
+
+  /* Give each equivalence class that occurs in more than one word's
+     worth of lines a mask, so that its lines need not be set one at a
+     time.  There are fewer than LCS_WORD_BITS such classes.  */
+  l.fmask = xicalloc (equiv_max, sizeof *l.fmask);
+  l.rmask = xicalloc (equiv_max, sizeof *l.rmask);
+  for (lin j = 0; j < ylines; j++)
+    {
+      lin c = l.yvec[j];
+      if (ylines < l.count[c] * LCS_WORD_BITS && !l.fmask[c])
+	{
+	  l.fmask[c] = xicalloc (l.ywords, sizeof *l.fmask[c]);
+	  l.rmask[c] = xicalloc (l.ywords, sizeof *l.rmask[c]);
+	  for (lin p = l.ystart[c]; p < l.ystart[c + 1]; p++)
+	    {
+	      lin k = l.ypos[p], r = ylines - 1 - k;
+	      lcs_set_bit (l.fmask[c], k);
+	      lcs_set_bit (l.rmask[c], r);
+	    }
+	}
+    }
+  for (lin j = 0; j < ylines; j++)
+    l.count[l.yvec[j]] = 0;
+
+  idx_t npairs = 1;
+  while (npairs < 2 * (xlines + ylines))
+    npairs *= 2;
+  l.pairs = xinmalloc (npairs, sizeof *l.pairs);
+  for (idx_t i = 0; i < npairs; i++)
+    l.pairs[i].a = -1;
+  l.pairs_mask = npairs - 1;
+  l.pairs_used = xinmalloc (xlines + ylines, sizeof *l.pairs_used);
+
+  l.vec = xinmalloc (l.ywords + 1, 2 * sizeof *l.vec);
+  l.match = l.vec + l.ywords + 1;
+  l.frow = xinmalloc (ylines + 1, 2 * sizeof *l.frow);
+  l.brow = l.frow + ylines + 1;
+
+  lcs_compare (&l, 0, xlines, 0, ylines);
+
+  free (l.frow);
+  free (l.vec);
+  free (l.pairs_used);
+  free (l.pairs);
+  for (lin j = 0; j < ylines; j++)
+    {
+      free (l.fmask[l.yvec[j]]);
+      free (l.rmask[l.yvec[j]]);
+      l.fmask[l.yvec[j]] = l.rmask[l.yvec[j]] = nullptr;
+    }
+  free (l.rmask);
+  free (l.fmask);
+  free (l.count);
+  free (l.ypos);
+  free (l.ystart);
+}
+
+/* Return a hash of H whose bits all depend on all bits of H.  */
+
+static size_t
+mix_hash (size_t h)
+{
+  h *= (size_t) 0x9e3779b97f4a7c15;
+  return h ^ h >> (SIZE_WIDTH / 2);
+}
+
+/* Runs of identical lines, like blank padding between records, make
+   compareseq follow each run along many diagonals.  With
+   --speed-large-files, compare the files as sequences of runs
+   instead, where a run of two or more identical lines is a single
+   element that matches only a run of the same lines and length.
+   Then compare again the lines of each pair of changed regions, so
+   that runs of different lengths still match in part.  */
+
+/* The class of runs of LENGTH lines of equivalence class CODE, in a
+   hash table where LENGTH is zero in unused slots.  */
+struct run_class
+{
+  lin code, length;
+  lin class;
+};
+
+/* Compare undiscarded lines OFF[0] up to LIM[0] of the first file of
+   FILEVEC with lines OFF[1] up to LIM[1] of the second as runs, with
+   the context CTXT.  Return false, doing nothing, if there are too
+   few runs of identical lines for this to be worthwhile.  */
+
+static bool
+compare_runs (struct context *ctxt, struct file_data filevec[],
+	      lin const off[2], lin const lim[2])
+{
+  lin nlines[2], nruns[2];
+  for (int f = 0; f < 2; f++)
+    {
+      lin const *u = filevec[f].undiscarded;
+      nlines[f] = lim[f] - off[f];
+      nruns[f] = 0 < nlines[f];
+      for (lin i = off[f] + 1; i < lim[f]; i++)
+	nruns[f] += u[i - 1] != u[i];
+    }
+  lin lines = nlines[0] + nlines[1], runs = nruns[0] + nruns[1];
+  if (lines - runs < lines / 4)
+    return false;
+
+  idx_t nslots = 1;
+  while (nslots < 2 * runs)
+    nslots *= 2;
+  struct run_class *classes = xinmalloc (nslots, sizeof *classes);
+  for (idx_t i = 0; i < nslots; i++)
+    classes[i].length = 0;
+  lin nclasses = filevec[0].equiv_max;
+
+  /* For each file F, VEC[F] holds the classes of its runs, START[F]
+     the indexes of their first undiscarded lines, followed by the
+     number of undiscarded lines, and REAL[F] the real indexes of
+     their first lines.  */
+  lin *vec[2], *start[2], *real[2];
+  lin *p = xinmalloc (runs + 2, 3 * sizeof *p);
+  for (int f = 0; f < 2; f++)
+    {
+      vec[f] = p;  p += nruns[f];
+      real[f] = p;  p += nruns[f];
+      start[f] = p;  p += nruns[f] + 1;
+
+      lin const *u = filevec[f].undiscarded;
+      lin k = 0;
+      for (lin i = off[f]; i < lim[f]; k++)
+	{
+	  lin code = u[i], j = i + 1;
+	  while (j < lim[f] && u[j] == code)
+	    j++;
+	  lin length = j - i, class = code;
+	  if (1 < length)
+	    {
+	      idx_t slot = mix_hash (mix_hash (code) + length) & (nslots - 1);
+	      for (; classes[slot].length; slot = (slot + 1) & (nslots - 1))
+		if (classes[slot].code == code
+		    && classes[slot].length == length)
+		  break;
+	      if (!classes[slot].length)
+		classes[slot] = (struct run_class) { code, length, nclasses++ };
+	      class = classes[slot].class;
+	    }
+	  vec[f][k] = class;
+	  real[f][k] = filevec[f].realindexes[i];
+	  start[f][k] = i;
+	  i = j;
+	}
+      start[f][k] = lim[f];
+    }
+  free (classes);
+
+  /* Compare the runs, noting each changed run as a change to its
+     first line, and then to all its lines.  */
+  struct context rctxt = *ctxt;
+  rctxt.xvec = vec[0];
+  rctxt.yvec = vec[1];
+  for (int f = 0; f < 2; f++)
+    curr.file[f].realindexes = real[f];
+  compareseq (0, nruns[0], 0, nruns[1], false, &rctxt);
+  for (int f = 0; f < 2; f++)
+    {
+      curr.file[f].realindexes = filevec[f].realindexes;
+      bool *changed = filevec[f].changed;
+      lin const *realindexes = filevec[f].realindexes;
+      for (lin k = 0; k < nruns[f]; k++)
+	if (changed[real[f][k]])
+	  for (lin i = start[f][k] + 1; i < start[f][k + 1]; i++)
+	    changed[realindexes[i]] = true;
+    }
+
+  /* Unchanged runs match in order.  Between each pair of them,
+     compare again the lines of regions changed in both files.  */
+  for (lin k0 = 0, k1 = 0; ; k0++, k1++)
+    {
+      lin g0 = k0, g1 = k1;
+      while (k0 < nruns[0] && filevec[0].changed[real[0][k0]])
+	k0++;
+      while (k1 < nruns[1] && filevec[1].changed[real[1][k1]])
+	k1++;
+      if (g0 < k0 && g1 < k1)
+	{
+	  lin xoff = start[0][g0], xlim = start[0][k0];
+	  lin yoff = start[1][g1], ylim = start[1][k1];
+	  for (lin i = xoff; i < xlim; i++)
+	    filevec[0].changed[filevec[0].realindexes[i]] = false;
+	  for (lin i = yoff; i < ylim; i++)
+	    filevec[1].changed[filevec[1].realindexes[i]] = false;
+	  compareseq (xoff, xlim, yoff, ylim, false, ctxt);
+	}
+      if (k0 == nruns[0])
+	break;
+    }
+
+  free (vec[0]);
+  return true;
+}
+
+/* Compare undiscarded lines OFF[0] up to LIM[0] of the first file of
+   FILEVEC with lines OFF[1] up to LIM[1] of the second, with the
+   context CTXT.  */
+
+static void
+compare_region (struct context *ctxt, struct file_data filevec[],
+		lin const off[2], lin const lim[2])
+{
+  if (! (speed_large_files && compare_runs (ctxt, filevec, off, lim)))
+    compareseq (off[0], lim[0], off[1], lim[1], false, ctxt);
+}
+
+/* When a large block of lines moves, or much is inserted, the common
+   prefix and suffix are short and compareseq must do all the work of
+   aligning the files.  With --speed-large-files, first split the
+   files into chunks of lines at boundaries that depend only on the
+   lines near them, so that chunks of identical text are split alike
+   wherever they are.  Chunks that occur exactly once in each file
+   match; a longest sequence of matching chunks that are in the same
+   order in both files anchors the comparison, which is then done
+   only between the anchors.  */
+
+/* A boundary follows a line when these bits of the rolling hash are
+   zero, which makes chunks about 64 lines long on average.  The hash
+   shifts one bit per line, so these bits depend on the last 16 or so
+   lines.  */
+enum { CHUNK_BOUNDARY_MASK = 0x3f << 10 };
+
+/* A chunk, in a hash table where LINES is null in unused slots.  */
+struct chunk
+{
+  /* The hash of the chunk, and its equivalence classes and their
+     number.  */
+  size_t hash;
+  lin const *lines;
+  lin length;
+
+  /* The number of occurrences in each file, and the index of the last
+     one.  */
+  lin count[2];
+  lin index[2];
+};
+
+/* Compare the undiscarded lines of FILEVEC with the context CTXT,
+   anchoring the comparison by chunks that match.  */
+
+static void
+compare_chunks (struct context *ctxt, struct file_data filevec[])
+{
+  /* Split each file F into NCHUNKS[F] chunks, where chunk K is lines
+     BOUND[F][K] up to BOUND[F][K + 1].  */
+  lin nlines[2], nchunks[2];
+  lin *bound[2];
+  for (int f = 0; f < 2; f++)
+    {
+      lin const *u = filevec[f].undiscarded;
+      nlines[f] = filevec[f].nondiscarded_lines;
+      bound[f] = xinmalloc (nlines[f] + 2, sizeof *bound[f]);
+      lin k = 0;
+      bound[f][k++] = 0;
+      size_t h = 0;
+      for (lin i = 0; i < nlines[f]; i++)
+	{
+	  h = (h << 1) + mix_hash (u[i]);
+	  if (! (h & CHUNK_BOUNDARY_MASK) && i + 1 < nlines[f])
+	    bound[f][k++] = i + 1;
+	}
+      bound[f][k] = nlines[f];
+      nchunks[f] = nlines[f] ? k : 0;
+    }
+
+  /* Find the equal chunks, and for each chunk of the first file that
+     occurs once in each file, the index of the matching chunk of the
+     second.  */
+  idx_t nslots = 1;
+  while (nslots < 2 * (nchunks[0] + nchunks[1]))
+    nslots *= 2;
+  struct chunk *chunks = xinmalloc (nslots, sizeof *chunks);
+  for (idx_t i = 0; i < nslots; i++)
+    chunks[i].lines = nullptr;
+  idx_t *slot0 = xinmalloc (nchunks[0] + 1, sizeof *slot0);
+  for (int f = 0; f < 2; f++)
+    for (lin k = 0; k < nchunks[f]; k++)
+      {
+	lin const *lines = filevec[f].undiscarded + bound[f][k];
+	lin length = bound[f][k + 1] - bound[f][k];
+	size_t h = length;
+	for (lin i = 0; i < length; i++)
+	  h = mix_hash (h + lines[i]);
+	idx_t slot = h & (nslots - 1);
+	for (; chunks[slot].lines; slot = (slot + 1) & (nslots - 1))
+	  if (chunks[slot].hash == h && chunks[slot].length == length
+	      && ! memcmp (chunks[slot].lines, lines, length * sizeof *lines))
+	    break;
+	struct chunk *c = &chunks[slot];
+	if (!c->lines)
+	  *c = (struct chunk) { .hash = h, .lines = lines, .length = length };
+	c->count[f]++;
+	c->index[f] = k;
+	if (f == 0)
+	  slot0[k] = slot;
+      }
+
+  /* Find a longest sequence of matching chunks in the same order in
+     both files, as in patience sorting: TAIL[L] is the first-file
+     index of the chunk that ends the best sequence of length L + 1
+     found so far, and PREV[K] is the index of the chunk before chunk
+     K in its sequence, or -1.  */
+  lin *tail = xinmalloc (nchunks[0] + 1, 2 * sizeof *tail);
+  lin *prev = tail + nchunks[0] + 1;
+  lin ntail = 0;
+  for (lin k = 0; k < nchunks[0]; k++)
+    {
+      struct chunk const *c = &chunks[slot0[k]];
+      if (! (c->count[0] == 1 && c->count[1] == 1))
+	continue;
+      lin j = c->index[1], lo = 0, hi = ntail;
+      while (lo < hi)
+	{
+	  lin mid = lo + (hi - lo) / 2;
+	  if (chunks[slot0[tail[mid]]].index[1] < j)
+	    lo = mid + 1;
+	  else
+	    hi = mid;
+	}
+      prev[k] = lo ? tail[lo - 1] : -1;
+      tail[lo] = k;
+      ntail += lo == ntail;
+    }
+
+  /* Compare the lines between the anchors, from last to first.  */
+  lin off[2], lim[2] = { nlines[0], nlines[1] };
+  for (lin k = ntail ? tail[ntail - 1] : -1; 0 <= k; k = prev[k])
+    {
+      lin j = chunks[slot0[k]].index[1];
+      off[0] = bound[0][k + 1];
+      off[1] = bound[1][j + 1];
+      compare_region (ctxt, filevec, off, lim);
+      lim[0] = bound[0][k];
+      lim[1] = bound[1][j];
+    }
+  off[0] = off[1] = 0;
+  compare_region (ctxt, filevec, off, lim);
+
+  free (tail);
+  free (slot0);
+  free (chunks);
+  free (bound[1]);
+  free (bound[0]);
+}
+
 /* Adjust inserts/deletes of identical lines to join changes
    as much as possible.
 
@@ -448,6 +1117,19 @@ briefly_report (int changes, struct file_data const filevec[])
 	     file_label[1] ? file_label[1] : squote (1, filevec[1].name));
 }
 
+/* Free the contents of the files of FILEVEC and their line tables.  */
+
+static void
+release_text (struct file_data filevec[])
+{
+  for (int f = 0; f < 2; f++)
+    free (filevec[f].linbuf + filevec[f].linbuf_base);
+  if (filevec[0].buffer != filevec[1].buffer)
+    free (filevec[0].buffer);
+  free (filevec[1].buffer);
+  filevec[0].buffer = filevec[1].buffer = nullptr;
+}
+
 /* Report the differences of two files.  */
 int
 diff_2_files (struct comparison *cmp)
@@ -458,9 +1140,18 @@ diff_2_files (struct comparison *cmp)
      compare the two files as binary.  This can happen
      only when the first chunk is read.
      Also, --brief without any --ignore-* options means
-     we can speed things up by treating the files as binary.  */
-
-  if (read_files (cmp->file, files_can_be_treated_as_binary))
+     we can speed things up by treating the files as binary.
+     With --brief and options that do not make the alignment of
+     lines matter, compare the files a line at a time instead.  */
+
+  bool stream = (brief && !files_can_be_treated_as_binary
+                 && !ignore_blank_lines && !ignore_regexp.fastmap
+                 && !compare_by_key && split_char == '\n'
+                 && robust_output_style (output_style));
+
+  if (stream
+      ? stream_files (cmp->file, &changes)
+      : read_files (cmp->file, files_can_be_treated_as_binary))
     {
       /* Files with different lengths must be different.  */
       if (cmp->file[0].stat.st_size != cmp->file[1].stat.st_size
@@ -519,6 +1210,14 @@ diff_2_files (struct comparison *cmp)
 
       briefly_report (changes, cmp->file);
     }
+  else if (stream)
+    briefly_report (changes, cmp->file);
+  else if (compare_by_key)
+    {
+      changes = diff_keyed_records (cmp);
+      if (brief)
+        briefly_report (changes, cmp->file);
+    }
   else
     {
       /* Allocate vectors for the results of comparison:
@@ -528,42 +1227,78 @@ diff_2_files (struct comparison *cmp)
 
       bool *flag_space = xizalloc (cmp->file[0].buffered_lines
 				   + cmp->file[1].buffered_lines + 4);
+      advise_huge_pages (flag_space, (cmp->file[0].buffered_lines
+				      + cmp->file[1].buffered_lines + 4));
       cmp->file[0].changed = flag_space + 1;
       cmp->file[1].changed = flag_space + cmp->file[0].buffered_lines + 3;
 
-      /* Some lines are obviously insertions or deletions
-         because they don't match anything.  Detect them now, and
-         avoid even thinking about them in the main comparison algorithm.  */
-
-      discard_confusing_lines (cmp->file);
-
-      /* Now do the main comparison algorithm, considering just the
-         undiscarded lines.  */
-
-      struct context ctxt;
-      ctxt.xvec = cmp->file[0].undiscarded;
-      ctxt.yvec = cmp->file[1].undiscarded;
-      lin diags = (cmp->file[0].nondiscarded_lines
-		   + cmp->file[1].nondiscarded_lines + 3);
-      ctxt.fdiag = xinmalloc (diags, 2 * sizeof *ctxt.fdiag);
-      ctxt.bdiag = ctxt.fdiag + diags;
-      ctxt.fdiag += cmp->file[1].nondiscarded_lines + 1;
-      ctxt.bdiag += cmp->file[1].nondiscarded_lines + 1;
-
-      ctxt.heuristic = speed_large_files;
-
-      /* Set TOO_EXPENSIVE to be the approximate square root of the
-         input size, bounded below by 4096.  4096 seems to be good for
-         circa-2016 CPUs; see Bug#16848 and Bug#24715.  */
-      lin too_expensive = (lin) 1 << ((floor_log2 (diags) >> 1) + 1);
-      ctxt.too_expensive = MAX (4096, too_expensive);
-
-      curr = *cmp;
-
-      compareseq (0, cmp->file[0].nondiscarded_lines,
-                  0, cmp->file[1].nondiscarded_lines, minimal, &ctxt);
-
-      free (ctxt.fdiag - (cmp->file[1].nondiscarded_lines + 1));
+      /* With --brief, the rest of the comparison needs only the
+         equivalence classes of lines, unless it must look at the
+         text of changed lines, so free the text now to lessen the
+         memory needed while comparing.  This matters only when the
+         files could not be compared a line at a time as they were
+         read, e.g., with --split-lines or with -e and -w.  */
+      bool sorted = (sorted_input
+                     & !cmp->file[0].unsorted & !cmp->file[1].unsorted);
+      bool text_released = (brief && !sorted && !ignore_blank_lines
+                            && !ignore_regexp.fastmap);
+      if (text_released)
+        release_text (cmp->file);
+
+      /* Sorted files can be compared by merging them.  If either
+         file turned out not to be sorted, fall back on the usual
+         algorithm.  */
+
+      if (sorted)
+        {
+          merge_sorted_lines (cmp->file);
+          curr = *cmp;
+        }
+      else
+        {
+          /* Some lines are obviously insertions or deletions
+             because they don't match anything.  Detect them now, and
+             avoid even thinking about them in the main comparison
+             algorithm.  */
+
+          discard_confusing_lines (cmp->file);
+
+          /* Now do the main comparison algorithm, considering just the
+             undiscarded lines.  */
+
+          struct context ctxt;
+          ctxt.xvec = cmp->file[0].undiscarded;
+          ctxt.yvec = cmp->file[1].undiscarded;
+          lin diags = (cmp->file[0].nondiscarded_lines
+                       + cmp->file[1].nondiscarded_lines + 3);
+          ctxt.fdiag = xinmalloc (diags, 2 * sizeof *ctxt.fdiag);
+          advise_huge_pages (ctxt.fdiag, diags * 2 * sizeof *ctxt.fdiag);
+          ctxt.bdiag = ctxt.fdiag + diags;
+          ctxt.fdiag += cmp->file[1].nondiscarded_lines + 1;
+          ctxt.bdiag += cmp->file[1].nondiscarded_lines + 1;
+
+          ctxt.heuristic = speed_large_files;
+
+          /* Set TOO_EXPENSIVE to be the approximate square root of the
+             input size, bounded below by 4096.  4096 seems to be good for
+             circa-2016 CPUs; see Bug#16848 and Bug#24715.  */
+          lin too_expensive = (lin) 1 << ((floor_log2 (diags) >> 1) + 1);
+          ctxt.too_expensive = MAX (4096, too_expensive);
+
+          curr = *cmp;
+
+          if (minimal)
+            compare_minimal (&ctxt, cmp->file[0].nondiscarded_lines,
+                             cmp->file[1].nondiscarded_lines,
+                             cmp->file[0].equiv_max);
+          else if (speed_large_files)
+            compare_chunks (&ctxt, cmp->file);
+          else
+            compareseq (0, cmp->file[0].nondiscarded_lines,
+                        0, cmp->file[1].nondiscarded_lines, false, &ctxt);
+
+          free (ctxt.fdiag - (cmp->file[1].nondiscarded_lines + 1));
+        }
 
       /* Modify the results slightly to make them prettier
          in cases where that can validly be done.  */
@@ -667,7 +1402,8 @@ diff_2_files (struct comparison *cmp)
       for (int f = 0; f < 2; f++)
         {
           free (cmp->file[f].equivs);
-          free (cmp->file[f].linbuf + cmp->file[f].linbuf_base);
+          if (!text_released)
+            free (cmp->file[f].linbuf + cmp->file[f].linbuf_base);
         }
 
       for (struct change *e = script; e; )
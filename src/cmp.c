@@ -57,9 +57,23 @@ hard_locale_LC_MESSAGES (void)
 }
 
 static int cmp (void);
+static int cmp_reference (idx_t, char *const *);
+static int cmp_resync (void);
 static off_t file_position (int);
+static off_t seek_initial (int, intmax_t);
+static bool skip_initial (int, char const *, struct stat const *, intmax_t,
+                          char *);
 static idx_t block_compare (word const *, word const *) ATTRIBUTE_PURE;
 static idx_t count_newlines (char *, idx_t);
+static idx_t find_differing_byte (char const *, char const *, idx_t, idx_t)
+  ATTRIBUTE_PURE;
+static idx_t find_equal_byte (char const *, char const *, idx_t, idx_t)
+  ATTRIBUTE_PURE;
+static void print_range (intmax_t, intmax_t, int);
+static void print_first_difference (char const *, char const *,
+                                    intmax_t, intmax_t,
+                                    unsigned char, unsigned char);
+static void print_eof (char const *, intmax_t, intmax_t, bool, bool);
 static void sprintc (char *, unsigned char);
 
 /* Filenames of the compared files.  */
@@ -91,11 +105,16 @@ static intmax_t ignore_initial[2];
    and special files are unlikely to support this optimization.  */
 static intmax_t bytes = INTMAX_MAX;
 
+/* If non-null, the name of the file that each operand is compared to.  */
+static char const *reference;
+
 /* Output format.  */
 static enum comparison_type
   {
     type_first_diff,	/* Print the first difference.  */
     type_all_diffs,	/* Print all differences.  */
+    type_ranges,	/* Print all ranges of differing bytes.  */
+    type_resync,	/* Print differing regions, realigning the files.  */
     type_no_stdout,	/* Do not output to stdout; only stderr.  */
     type_status		/* Exit status only.  */
   } comparison_type;
@@ -103,10 +122,17 @@ static enum comparison_type
 /* If nonzero, print values of bytes quoted like cat -t does. */
 static bool opt_print_bytes;
 
+/* With --resync, the greatest number of bytes of each file to search
+   for the point where the files are back in step after a difference.  */
+static idx_t resync_window = 1024 * 1024;
+
 /* Values for long options that do not have single-letter equivalents.  */
 enum
 {
-  HELP_OPTION = CHAR_MAX + 1
+  HELP_OPTION = CHAR_MAX + 1,
+  RANGES_OPTION,
+  REFERENCE_OPTION,
+  RESYNC_OPTION
 };
 
 static char const shortopts[] = "bci:ln:sv";
@@ -119,6 +145,9 @@ static struct option const longopts[] =
   {"bytes", 1, 0, 'n'},
   {"silent", 0, 0, 's'},
   {"quiet", 0, 0, 's'},
+  {"ranges", 0, 0, RANGES_OPTION},
+  {"reference", 1, 0, REFERENCE_OPTION},
+  {"resync", 2, 0, RESYNC_OPTION},
   {"version", 0, 0, 'v'},
   {"help", 0, 0, HELP_OPTION},
   {0, 0, 0, 0}
@@ -150,7 +179,8 @@ static void
 specify_comparison_type (enum comparison_type t)
 {
   if (comparison_type && comparison_type != t)
-    try_help ("options -l and -s are incompatible", nullptr);
+    try_help ("options -l, -s, --ranges, and --resync are incompatible",
+              nullptr);
   comparison_type = t;
 }
 
@@ -163,6 +193,42 @@ check_stdout (void)
     error (EXIT_TROUBLE, errno, "%s", _("standard output"));
 }
 
+/* Open the input file NAME, storing its file descriptor into *DESC
+   and its status into *ST.  Return true if successful; otherwise
+   diagnose the problem unless -s is in effect, and return false.  */
+static bool
+open_input (char const *name, int *desc, struct stat *st)
+{
+  if (STREQ (name, "-"))
+    {
+      *desc = STDIN_FILENO;
+      if (O_BINARY && ! isatty (STDIN_FILENO))
+        set_binary_mode (STDIN_FILENO, O_BINARY);
+    }
+  else
+    {
+      *desc = open (name, O_RDONLY | O_BINARY | O_CLOEXEC);
+
+      if (*desc < 0)
+        {
+          if (comparison_type != type_status)
+            error (0, errno, "%s", squote (0, name));
+          return false;
+        }
+    }
+
+  if (fstat (*desc, st) < 0)
+    {
+      st->st_size = -2;
+#if HAVE_STRUCT_STAT_ST_BLKSIZE
+      st->st_blksize = 8 * 1024;
+#endif
+    }
+  else
+    st->st_size = stat_size (st);
+  return true;
+}
+
 static char const *const option_help_msgid[] = {
   N_("-b, --print-bytes          print differing bytes"),
   N_("-i, --ignore-initial=SKIP         skip first SKIP bytes of both inputs"),
@@ -170,6 +236,9 @@ static char const *const option_help_msgid[] = {
      "                                      first SKIP2 bytes of FILE2"),
   N_("-l, --verbose              output byte numbers and differing byte values"),
   N_("-n, --bytes=LIMIT          compare at most LIMIT bytes"),
+  N_("    --ranges               output ranges of differing bytes"),
+  N_("    --reference=REF        compare REF to each FILE operand"),
+  N_("    --resync[=WINDOW]      output changed regions, resyncing after insertions"),
   N_("-s, --quiet, --silent      suppress all normal output"),
   N_("    --help                 display this help and exit"),
   N_("-v, --version              output version information and exit"),
@@ -181,6 +250,8 @@ usage (void)
 {
   printf (_("Usage: %s [OPTION]... FILE1 [FILE2 [SKIP1 [SKIP2]]]\n"),
 	  squote (0, program_name));
+  printf (_("  or:  %s [OPTION]... --reference=REF FILE...\n"),
+	  squote (0, program_name));
   puts (_("Compare two files byte by byte."));
   printf ("\n%s\n\n",
 _("The optional SKIP1 and SKIP2 specify the number of bytes to skip\n"
@@ -255,6 +326,27 @@ main (int argc, char **argv)
         check_stdout ();
         return EXIT_SUCCESS;
 
+      case RANGES_OPTION:
+        specify_comparison_type (type_ranges);
+        break;
+
+      case REFERENCE_OPTION:
+        reference = optarg;
+        break;
+
+      case RESYNC_OPTION:
+        specify_comparison_type (type_resync);
+        if (optarg)
+          {
+            intmax_t n;
+            strtol_error e = xstrtoimax (optarg, nullptr, 0, &n,
+                                         valid_suffixes);
+            if ((e & ~LONGINT_OVERFLOW) != LONGINT_OK || n <= 0)
+              try_help ("invalid --resync value %s", quote (optarg));
+            resync_window = MIN (n, IDX_MAX / 4);
+          }
+        break;
+
       case HELP_OPTION:
         usage ();
         check_stdout ();
@@ -267,19 +359,34 @@ main (int argc, char **argv)
   if (optind == argc)
     try_help ("missing operand after %s", quote (argv[argc - 1]));
 
-  file[0] = argv[optind++];
-  file[1] = optind < argc ? argv[optind++] : "-";
-
-  for (int f = 0; f < 2 && optind < argc; f++)
+  /* With --reference, every operand is a file to compare to REF.  */
+  int nfiles = 2;
+  if (reference)
     {
-      char *arg = argv[optind++];
-      specify_ignore_initial (f, &arg, 0);
+      if (type_all_diffs <= comparison_type
+          && comparison_type <= type_resync)
+        try_help (("option --reference is incompatible with"
+                   " -l, --ranges, and --resync"),
+                  nullptr);
+      file[0] = reference;
+      nfiles = 1;
     }
+  else
+    {
+      file[0] = argv[optind++];
+      file[1] = optind < argc ? argv[optind++] : "-";
 
-  if (optind < argc)
-    try_help ("extra operand %s", quote (argv[optind]));
+      for (int f = 0; f < 2 && optind < argc; f++)
+        {
+          char *arg = argv[optind++];
+          specify_ignore_initial (f, &arg, 0);
+        }
 
-  for (int f = 0; f < 2; f++)
+      if (optind < argc)
+        try_help ("extra operand %s", quote (argv[optind]));
+    }
+
+  for (int f = 0; f < nfiles; f++)
     {
       /* Two files with the same name and offset are identical.
          But wait until we open the file once, for proper diagnostics.  */
@@ -287,39 +394,15 @@ main (int argc, char **argv)
           && file_name_cmp (file[0], file[1]) == 0)
         return EXIT_SUCCESS;
 
-      if (STREQ (file[f], "-"))
-        {
-          file_desc[f] = STDIN_FILENO;
-          if (O_BINARY && ! isatty (STDIN_FILENO))
-            set_binary_mode (STDIN_FILENO, O_BINARY);
-        }
-      else
-        {
-          file_desc[f] = open (file[f], O_RDONLY | O_BINARY | O_CLOEXEC);
-
-          if (file_desc[f] < 0)
-            {
-              if (comparison_type != type_status)
-		error (0, errno, "%s", squote (0, file[f]));
-              exit (EXIT_TROUBLE);
-            }
-        }
-
-      if (fstat (file_desc[f], stat_buf + f) < 0)
-        {
-	  stat_buf[f].st_size = -2;
-#if HAVE_STRUCT_STAT_ST_BLKSIZE
-          stat_buf[f].st_blksize = 8 * 1024;
-#endif
-        }
-      else
-	stat_buf[f].st_size = stat_size (&stat_buf[f]);
+      if (! open_input (file[f], &file_desc[f], &stat_buf[f]))
+        exit (EXIT_TROUBLE);
     }
 
   /* If the files are the same and have the same file position,
      the contents are identical.  */
 
-  if (-1 <= stat_buf[0].st_size && -1 <= stat_buf[1].st_size
+  if (!reference
+      && -1 <= stat_buf[0].st_size && -1 <= stat_buf[1].st_size
       && same_file (&stat_buf[0], &stat_buf[1])
       && file_position (0) == file_position (1))
     return EXIT_SUCCESS;
@@ -344,7 +427,7 @@ main (int argc, char **argv)
      conclude that the files differ if they have different sizes
      and if more bytes will be compared than are in the smaller file.  */
 
-  if (type_no_stdout <= comparison_type
+  if (!reference && type_no_stdout <= comparison_type
       && 0 <= stat_buf[0].st_size && S_ISREG (stat_buf[0].st_mode)
       && 0 <= stat_buf[1].st_size && S_ISREG (stat_buf[1].st_mode))
     {
@@ -381,9 +464,13 @@ main (int argc, char **argv)
   buffer[0] = xinmalloc (words_per_buffer, 2 * sizeof (word));
   buffer[1] = buffer[0] + words_per_buffer;
 
-  int exit_status = cmp ();
+  int exit_status = (reference
+                     ? cmp_reference (argc - optind, argv + optind)
+                     : comparison_type == type_resync
+                     ? cmp_resync ()
+                     : cmp ());
 
-  for (int f = 0; f < 2; f++)
+  for (int f = 0; f < nfiles; f++)
     if (close (file_desc[f]) != 0)
       error (EXIT_TROUBLE, errno, "%s", squote (0, file[f]));
   if (exit_status != EXIT_SUCCESS && comparison_type < type_no_stdout)
@@ -404,12 +491,12 @@ cmp (void)
   char *buf0 = (char *) buffer0;
   char *buf1 = (char *) buffer1;
 
-  /* For -l, the print width of the offset, a positive number.
+  /* For -l and --ranges, the print width of the offset, a positive number.
      Otherwise, the negative of the comparison type.
      This portmanteauization pacifies gcc -Wmaybe-uninitialized.  */
   int offset_width;
 
-  if (comparison_type == type_all_diffs)
+  if (comparison_type == type_all_diffs || comparison_type == type_ranges)
     {
       intmax_t byte_number_max = bytes;
 
@@ -431,53 +518,16 @@ cmp (void)
   bool eof[2] = { false, false };
 
   for (int f = 0; f < 2; f++)
-    {
-      intmax_t ig = ignore_initial[f];
-      if (ig == 0)
-	continue;
-
-      if (0 <= file_position (f))
-	continue;  /* lseek sufficed.  */
-
-      if (! (0 <= ig && ig < TYPE_MAXIMUM (off_t))
-	  && -1 <= stat_buf[f].st_size && S_ISREG (stat_buf[f].st_mode))
-        {
-	  /* When ignoring at least TYPE_MAXIMUM (off_t) bytes
-	     of a regular file, pretend to be at end of file,
-	     as lseeking to TYPE_MAXIMUM (off_t) might tickle a kernel bug,
-	     and lseeking to file end would race with a growing file.  */
-	  eof[f] = true;
-	}
-      else if (ig < 0)
-	{
-	  /* Report an error if asked to ignore more than
-	     INTMAX_MAX bytes of a non-regular file,
-	     as the actual number of bytes to ignore is not known.  */
-	  error (EXIT_TROUBLE, EOVERFLOW, "%s", squote (0, file[f]));
-	}
-      else
-	{
-	  /* Read and discard the ignored initial prefix.  */
-          do
-            {
-              idx_t bytes_to_read = MIN (ig, buf_size);
-              ptrdiff_t r = block_read (file_desc[f], buf0, bytes_to_read);
-              if (r != bytes_to_read)
-                {
-                  if (r < 0)
-		    error (EXIT_TROUBLE, errno, "%s", squote (0, file[f]));
-                  break;
-                }
-              ig -= r;
-            }
-	  while (0 < ig);
-        }
-    }
+    if (ignore_initial[f] != 0 && file_position (f) < 0)
+      eof[f] = skip_initial (file_desc[f], file[f], &stat_buf[f],
+                             ignore_initial[f], buf0);
 
   bool at_line_start = true;
   intmax_t line_number = 1;	/* Line number (1...) of difference. */
   intmax_t byte_number = 1;	/* Byte number (1...) of difference. */
   intmax_t remaining = bytes;	/* Remaining bytes to compare, or -1.  */
+  intmax_t range_start = 0;	/* Start (1...) of pending --ranges run.  */
+  int differing = 0;		/* Negative if differences were output.  */
 
   while (true)
     {
@@ -518,6 +568,14 @@ cmp (void)
           first_diff = block_compare (buffer0, buffer1);
         }
 
+      /* A --ranges run left pending by the previous block ends here
+         unless this block starts with a difference.  */
+      if (range_start && first_diff != 0)
+        {
+          print_range (range_start, byte_number, offset_width);
+          range_start = 0;
+        }
+
       byte_number += first_diff;
       if (offset_width == -type_first_diff && first_diff != 0)
         {
@@ -525,56 +583,45 @@ cmp (void)
           at_line_start = buf0[first_diff - 1] == '\n';
         }
 
-      int differing = 0;
-
       if (first_diff < smaller)
         {
 	  switch (offset_width)
             {
 	    case -type_first_diff:
-              {
-                if (!opt_print_bytes)
-                  {
-                    /* See POSIX for this format.  This message is
-                       used only in the POSIX locale, so it need not
-                       be translated.  */
-                    static char const char_message[] =
-		      "%s %s differ: char %"PRIdMAX", line %"PRIdMAX"\n";
-
-                    /* The POSIX rationale recommends using the word
-                       "byte" outside the POSIX locale.  Some gettext
-                       implementations translate even in the POSIX
-                       locale if certain other environment variables
-                       are set, so use "byte" if a translation is
-                       available, or if outside the POSIX locale.  */
-                    static char const byte_msgid[] =
-		      N_("%s %s differ: byte %"PRIdMAX", line %"PRIdMAX"\n");
-                    char const *byte_message = _(byte_msgid);
-                    bool use_byte_message = (byte_message != byte_msgid
-                                             || hard_locale_LC_MESSAGES ());
-
-                    printf (use_byte_message ? byte_message : char_message,
-			    file[0], file[1], byte_number, line_number);
-                  }
-                else
-                  {
-                    unsigned char c0 = buf0[first_diff];
-                    unsigned char c1 = buf1[first_diff];
-                    char s0[5];
-                    char s1[5];
-                    sprintc (s0, c0);
-                    sprintc (s1, c1);
-		    printf (_("%s %s differ: byte %"PRIdMAX", line %"PRIdMAX
-			      " is %3o %s %3o %s\n"),
-			    file[0], file[1], byte_number, line_number,
-                            c0, s0, c1, s1);
-                  }
-              }
+	      print_first_difference (file[0], file[1],
+				      byte_number, line_number,
+				      buf0[first_diff], buf1[first_diff]);
               FALLTHROUGH;
 	    case -type_status:
               return EXIT_FAILURE;
 
 	    default:
+	      if (comparison_type == type_ranges)
+		{
+		  /* Skip over runs of differing and of equal bytes in bulk,
+		     leaving a run that reaches the end of the block pending
+		     so that it can be merged with the next block.  */
+		  intmax_t base = byte_number - first_diff;
+		  if (!range_start)
+		    range_start = byte_number;
+		  while ((first_diff = find_equal_byte (buf0, buf1, first_diff,
+							smaller))
+			 < smaller)
+		    {
+		      print_range (range_start, base + first_diff,
+				   offset_width);
+		      range_start = 0;
+		      first_diff = find_differing_byte (buf0, buf1, first_diff,
+							smaller);
+		      if (first_diff == smaller)
+			break;
+		      range_start = base + first_diff;
+		    }
+		  byte_number = base + smaller;
+		  differing = -1;
+		  break;
+		}
+
 	      dassert (comparison_type == type_all_diffs);
 
               do
@@ -613,24 +660,14 @@ cmp (void)
             }
         }
 
+      if (range_start && (read0 != read1 || read0 != buf_size))
+        print_range (range_start, byte_number, offset_width);
+
       if (read0 != read1)
         {
-	  /* POSIX says that each of these format strings must be
-	     "cmp: EOF on %s", optionally followed by a blank and
-	     extra text sans newline, then terminated by "\n".  */
 	  if (differing <= 0 && offset_width != -type_status)
-	    fprintf (stderr,
-		     _(byte_number == 1
-		       ? N_("cmp: EOF on %s which is empty\n")
-		       : offset_width != -type_first_diff
-		       ? N_("cmp: EOF on %s after byte %"PRIdMAX"\n")
-		       : at_line_start
-		       ? N_("cmp: EOF on %s after byte %"PRIdMAX","
-			    " line %"PRIdMAX"\n")
-		       : N_("cmp: EOF on %s after byte %"PRIdMAX","
-			    " in line %"PRIdMAX"\n")),
-		     quote (file[read1 < read0]),
-		     byte_number - 1, line_number - at_line_start);
+	    print_eof (file[read1 < read0], byte_number, line_number,
+		       at_line_start, offset_width == -type_first_diff);
           return EXIT_FAILURE;
         }
 
@@ -639,6 +676,452 @@ cmp (void)
     }
 }
 
+/* A file being compared to the reference file.  */
+struct target
+{
+  char const *name;
+  int desc;
+  bool eof;	/* Whether to pretend the file is at its end.  */
+};
+
+/* Compare the reference file already open on 'file_desc[0]' to each
+   of the NTARGETS files named by TARGETS, using 'buffer[0]' for the
+   reference and 'buffer[1]' for each target in turn.  Read each block
+   of the reference only once, and stop reading a target as soon as its
+   outcome is known.  Return EXIT_SUCCESS if all targets are identical
+   to the reference, EXIT_FAILURE if any differ, >1 if error.  */
+
+static int
+cmp_reference (idx_t ntargets, char *const *targets)
+{
+  char *buf0 = (char *) buffer[0];
+  char *buf1 = (char *) buffer[1];
+  int exit_status = EXIT_SUCCESS;
+
+  bool eof0 = (ignore_initial[0] != 0 && file_position (0) < 0
+               && skip_initial (file_desc[0], file[0], &stat_buf[0],
+                                ignore_initial[0], buf0));
+
+  /* Open the targets, keeping only those whose outcome is not
+     yet known.  */
+  struct target *active = xinmalloc (ntargets, sizeof *active);
+  idx_t nactive = 0;
+  for (idx_t i = 0; i < ntargets; i++)
+    {
+      struct target *t = &active[nactive];
+      struct stat st;
+      t->name = targets[i];
+      if (! open_input (t->name, &t->desc, &st))
+        {
+          exit_status = EXIT_TROUBLE;
+          continue;
+        }
+
+      off_t pos = seek_initial (t->desc, ignore_initial[1]);
+      if (-1 <= stat_buf[0].st_size && -1 <= st.st_size
+          && same_file (&stat_buf[0], &st) && pos == file_position (0))
+        {
+          /* Same file at the same position; the contents are identical.  */
+          if (t->desc != STDIN_FILENO && close (t->desc) != 0)
+            error (EXIT_TROUBLE, errno, "%s", squote (0, t->name));
+          continue;
+        }
+
+      t->eof = (ignore_initial[1] != 0 && pos < 0
+                && skip_initial (t->desc, t->name, &st, ignore_initial[1],
+                                 buf1));
+      nactive++;
+    }
+
+  bool at_line_start = true;
+  intmax_t line_number = 1;	/* Line number (1...) of block start.  */
+  intmax_t byte_number = 1;	/* Byte number (1...) of block start.  */
+  intmax_t remaining = bytes;	/* Remaining bytes to compare.  */
+
+  while (0 < nactive)
+    {
+      idx_t bytes_to_read = MIN (buf_size, remaining);
+      remaining -= bytes_to_read;
+
+      ptrdiff_t read0 = (eof0 ? 0
+			 : block_read (file_desc[0], buf0, bytes_to_read));
+      if (read0 < 0)
+	error (EXIT_TROUBLE, errno, "%s", squote (0, file[0]));
+
+      idx_t n = 0;
+      for (idx_t i = 0; i < nactive; i++)
+        {
+          struct target *t = &active[i];
+          ptrdiff_t read1 = (t->eof ? 0
+                             : block_read (t->desc, buf1, bytes_to_read));
+          int status;
+
+          if (read1 < 0)
+            {
+              if (comparison_type != type_status)
+                error (0, errno, "%s", squote (0, t->name));
+              status = EXIT_TROUBLE;
+            }
+          else
+            {
+              idx_t smaller = MIN (read0, read1);
+              idx_t first_diff = (memcmp (buf0, buf1, smaller) == 0
+                                  ? smaller
+                                  : find_differing_byte (buf0, buf1,
+                                                         0, smaller));
+              bool lines = comparison_type == type_first_diff;
+
+              if (first_diff < smaller)
+                {
+                  if (lines)
+                    print_first_difference (file[0], t->name,
+                                            byte_number + first_diff,
+                                            (line_number
+                                             + count_newlines (buf0,
+                                                               first_diff)),
+                                            buf0[first_diff],
+                                            buf1[first_diff]);
+                  status = EXIT_FAILURE;
+                }
+              else if (read0 != read1)
+                {
+                  if (comparison_type != type_status)
+                    print_eof (read1 < read0 ? t->name : file[0],
+                               byte_number + smaller,
+                               (lines
+                                ? line_number + count_newlines (buf0, smaller)
+                                : line_number),
+                               (lines && smaller
+                                ? buf0[smaller - 1] == '\n'
+                                : at_line_start),
+                               lines);
+                  status = EXIT_FAILURE;
+                }
+              else if (read0 == buf_size)
+                {
+                  /* Identical so far; keep comparing this target.  */
+                  active[n++] = *t;
+                  continue;
+                }
+              else
+                status = EXIT_SUCCESS;
+            }
+
+          if (t->desc != STDIN_FILENO && close (t->desc) != 0)
+            error (EXIT_TROUBLE, errno, "%s", squote (0, t->name));
+          exit_status = MAX (exit_status, status);
+        }
+      nactive = n;
+
+      if (nactive && comparison_type == type_first_diff)
+        {
+          line_number += count_newlines (buf0, read0);
+          at_line_start = buf0[read0 - 1] == '\n';
+        }
+      byte_number += read0;
+    }
+
+  free (active);
+  return exit_status;
+}
+
+/* With --resync, the number of bytes that must agree after a
+   difference for the files to be back in step, the size of the
+   smallest window searched for them, and the multiplier of the
+   rolling hash used to find them.  */
+enum { RESYNC_MATCH = 32, RESYNC_MIN_WINDOW = 256, RESYNC_BASE = 257 };
+
+/* An input being compared with --resync.  BUF, of size ALLOC, holds
+   LEN bytes of the input, of which those before POS have been dealt
+   with, and whose first is at offset OFFSET (0...) in the input.
+   REMAINING is the number of bytes that -n permits reading, and EOF
+   says whether the input has no more bytes to read.  */
+struct resync_input
+{
+  char *buf;
+  idx_t alloc;
+  idx_t pos;
+  idx_t len;
+  intmax_t offset;
+  intmax_t remaining;
+  bool eof;
+};
+
+/* Tables for finding where inputs are back in step.  HEAD[H & MASK]
+   is the first offset of a run of RESYNC_MATCH bytes with hash H in
+   the second input, or -1; NEXT[D] is the next offset after D in the
+   same chain, and HASH[D] the hash of the bytes at offset D.  */
+struct resync_tables
+{
+  idx_t *head;
+  idx_t mask;
+  idx_t *next;
+  size_t *hash;
+  idx_t alloc;
+};
+
+/* If IN, which is input F, has fewer than WANT bytes buffered after
+   its position, read more unless it is at end of file.  Return the
+   number of bytes buffered after its position.  */
+
+static idx_t
+resync_fill (struct resync_input *in, int f, idx_t want)
+{
+  idx_t avail = in->len - in->pos;
+  if (avail < want && !in->eof)
+    {
+      memmove (in->buf, in->buf + in->pos, avail);
+      in->offset += in->pos;
+      in->pos = 0;
+      in->len = avail;
+      if (in->alloc < want + buf_size)
+        in->buf = xpalloc (in->buf, &in->alloc,
+                           want + buf_size - in->alloc, -1, 1);
+
+      do
+        {
+          idx_t size = MIN (in->alloc - in->len, in->remaining);
+          ptrdiff_t n = block_read (file_desc[f], in->buf + in->len, size);
+          if (n < 0)
+            error (EXIT_TROUBLE, errno, "%s", squote (0, file[f]));
+          in->len += n;
+          in->remaining -= n;
+          in->eof = n < size || in->remaining == 0;
+        }
+      while (in->len < want && !in->eof);
+      avail = in->len;
+    }
+  return avail;
+}
+
+/* Return the number of leading bytes that P0 and P1 have in common,
+   out of the first N.  */
+
+static idx_t
+common_prefix (char const *p0, char const *p1, idx_t n)
+{
+  enum { CHUNK = 1024 };
+  idx_t i = 0;
+  while (CHUNK <= n - i && memcmp (p0 + i, p1 + i, CHUNK) == 0)
+    i += CHUNK;
+  while (i < n && p0[i] == p1[i])
+    i++;
+  return i;
+}
+
+/* Search the first WINDOW bytes after the positions of the inputs IN,
+   which differ there, for where they are back in step, using the
+   tables T.  On success, set D[F] to the number of bytes of input F
+   before that point, minimizing their sum, and return true.  */
+
+static bool
+resync_search (struct resync_input in[2], idx_t window,
+               struct resync_tables *t, idx_t d[2])
+{
+  idx_t avail[2];
+  for (int f = 0; f < 2; f++)
+    avail[f] = resync_fill (&in[f], f, window + RESYNC_MATCH);
+  char const *p0 = in[0].buf + in[0].pos, *p1 = in[1].buf + in[1].pos;
+
+  /* Index the runs of RESYNC_MATCH bytes of the second input that
+     start within the window.  */
+  idx_t nstarts = (avail[1] < RESYNC_MATCH ? 0
+                   : MIN (window, avail[1] - RESYNC_MATCH) + 1);
+  if (!t->head || t->alloc < nstarts)
+    {
+      free (t->head);
+      free (t->hash);
+      t->alloc = MAX (nstarts, RESYNC_MIN_WINDOW);
+      idx_t nslots = 1;
+      while (nslots < 2 * t->alloc)
+        nslots *= 2;
+      t->head = xinmalloc (nslots, sizeof *t->head);
+      t->mask = nslots - 1;
+      t->hash = xinmalloc (t->alloc, sizeof *t->hash + sizeof *t->next);
+      t->next = (idx_t *) (t->hash + t->alloc);
+    }
+
+  /* Use only as much of the table as this window needs, so that
+     small differences stay cheap after large ones.  */
+  idx_t mask = t->mask;
+  while (RESYNC_MIN_WINDOW < mask && nstarts <= mask >> 2)
+    mask >>= 1;
+  for (idx_t i = 0; i <= mask; i++)
+    t->head[i] = -1;
+
+  size_t power = 1;
+  for (int i = 0; i < RESYNC_MATCH; i++)
+    power *= RESYNC_BASE;
+  size_t h = 0;
+  for (idx_t i = 0; i < nstarts + RESYNC_MATCH - 1; i++)
+    {
+      h = h * RESYNC_BASE + (unsigned char) p1[i];
+      if (RESYNC_MATCH <= i)
+        h -= power * (unsigned char) p1[i - RESYNC_MATCH];
+      if (RESYNC_MATCH - 1 <= i)
+        t->hash[i - (RESYNC_MATCH - 1)] = h;
+    }
+  for (idx_t d1 = nstarts; 0 < d1--; )
+    {
+      idx_t *head = &t->head[t->hash[d1] & mask];
+      t->next[d1] = *head;
+      *head = d1;
+    }
+
+  /* Find the match with the least sum of offsets, trying offsets in
+     the first input in increasing order, and in the second in the
+     increasing order of the chains.  */
+  idx_t best = IDX_MAX;
+  idx_t nstarts0 = (avail[0] < RESYNC_MATCH ? 0
+                    : MIN (window, avail[0] - RESYNC_MATCH) + 1);
+  h = 0;
+  for (idx_t i = 0; i < nstarts0 + RESYNC_MATCH - 1; i++)
+    {
+      h = h * RESYNC_BASE + (unsigned char) p0[i];
+      if (RESYNC_MATCH <= i)
+        h -= power * (unsigned char) p0[i - RESYNC_MATCH];
+      idx_t d0 = i - (RESYNC_MATCH - 1);
+      if (d0 < 0)
+        continue;
+      if (best <= d0)
+        break;
+      for (idx_t d1 = t->head[h & mask]; 0 <= d1 && d0 + d1 < best;
+           d1 = t->next[d1])
+        if (t->hash[d1] == h
+            && memcmp (p0 + d0, p1 + d1, RESYNC_MATCH) == 0)
+          {
+            best = d0 + d1;
+            d[0] = d0;
+            d[1] = d1;
+          }
+    }
+
+  /* If both inputs end within the window, they are also back in step
+     where their remaining bytes agree, even if there are fewer than
+     RESYNC_MATCH of them, and at their ends.  */
+  if (in[0].eof && in[1].eof && avail[0] <= window && avail[1] <= window)
+    for (idx_t d0 = MAX (0, avail[0] - (RESYNC_MATCH - 1));
+         d0 <= avail[0]; d0++)
+      {
+        idx_t d1 = d0 - avail[0] + avail[1];
+        if (0 <= d1 && d0 + d1 < best
+            && memcmp (p0 + d0, p1 + d1, avail[0] - d0) == 0)
+          {
+            best = d0 + d1;
+            d[0] = d0;
+            d[1] = d1;
+          }
+      }
+
+  return best < IDX_MAX;
+}
+
+/* Print the byte numbers START through END, or just END if START is
+   not less than END.  */
+
+static void
+print_byte_range (intmax_t start, intmax_t end)
+{
+  if (start < end)
+    printf ("%"PRIdMAX",%"PRIdMAX, start, end);
+  else
+    printf ("%"PRIdMAX, end);
+}
+
+/* Print the region of LEN[F] bytes starting at offset START[F] (0...)
+   of each input F, where the inputs differ, in the style of a normal
+   diff.  */
+
+static void
+print_region (intmax_t const start[2], intmax_t const len[2])
+{
+  print_byte_range (start[0] + 1, start[0] + len[0]);
+  putchar (!len[0] ? 'a' : !len[1] ? 'd' : 'c');
+  print_byte_range (start[1] + 1, start[1] + len[1]);
+  putchar ('\n');
+}
+
+/* Compare the two files already open on 'file_desc[0]' and
+   'file_desc[1]', printing each region where they differ.  After a
+   difference, search for where the files are back in step, so that
+   bytes inserted in or deleted from one file cause only one region
+   to be printed.  Return EXIT_SUCCESS if identical, EXIT_FAILURE if
+   different, >1 if error.  */
+
+static int
+cmp_resync (void)
+{
+  struct resync_input in[2];
+  for (int f = 0; f < 2; f++)
+    {
+      in[f] = (struct resync_input) { .remaining = bytes };
+      in[f].eof = (ignore_initial[f] != 0 && file_position (f) < 0
+                   && skip_initial (file_desc[f], file[f], &stat_buf[f],
+                                    ignore_initial[f], (char *) buffer[0]));
+    }
+  struct resync_tables t = {0};
+
+  /* The region being accumulated, if LEN[0] or LEN[1] is nonzero.  */
+  intmax_t start[2], len[2] = {0, 0};
+
+  bool differing = false;
+  while (true)
+    {
+      idx_t avail[2];
+      for (int f = 0; f < 2; f++)
+        avail[f] = resync_fill (&in[f], f, 1);
+      idx_t n = MIN (avail[0], avail[1]);
+      idx_t same = common_prefix (in[0].buf + in[0].pos,
+                                  in[1].buf + in[1].pos, n);
+      if (same && (len[0] | len[1]))
+        {
+          print_region (start, len);
+          len[0] = len[1] = 0;
+        }
+      for (int f = 0; f < 2; f++)
+        in[f].pos += same;
+      if (same == n && n)
+        continue;
+      if (! (avail[0] | avail[1]))
+        break;
+
+      differing = true;
+      if (! (len[0] | len[1]))
+        for (int f = 0; f < 2; f++)
+          start[f] = in[f].offset + in[f].pos;
+
+      /* Search windows of increasing size, so that the work is
+         proportional to the size of the region.  */
+      idx_t d[2];
+      for (idx_t window = MIN (RESYNC_MIN_WINDOW, resync_window); ;
+           window = MIN (2 * window, resync_window))
+        {
+          if (resync_search (in, window, &t, d))
+            break;
+          if (window == resync_window)
+            {
+              /* Give up, and treat the whole window as differing.  */
+              for (int f = 0; f < 2; f++)
+                d[f] = MIN (window, in[f].len - in[f].pos);
+              break;
+            }
+        }
+      for (int f = 0; f < 2; f++)
+        {
+          in[f].pos += d[f];
+          len[f] += d[f];
+        }
+    }
+
+  if (len[0] | len[1])
+    print_region (start, len);
+  free (t.head);
+  free (t.hash);
+  for (int f = 0; f < 2; f++)
+    free (in[f].buf);
+  return differing ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 /* Compare two blocks of memory P0 and P1 until they differ.
    If the blocks are not guaranteed to be different, put sentinels at the ends
    of the blocks before calling this function.
@@ -667,6 +1150,140 @@ block_compare (word const *p0, word const *p1)
   return c0 - (char const *) p0;
 }
 
+/* Return the offset of the first byte at or after offset I where the
+   word-aligned blocks P0 and P1 differ, or LIM if there is no such
+   byte before offset LIM.  */
+
+static idx_t
+find_differing_byte (char const *p0, char const *p1, idx_t i, idx_t lim)
+{
+  while (i < lim && i % sizeof (word) != 0 && p0[i] == p1[i])
+    i++;
+
+  if (i % sizeof (word) == 0)
+    while (sizeof (word) <= lim - i
+           && *(word const *) (p0 + i) == *(word const *) (p1 + i))
+      i += sizeof (word);
+
+  while (i < lim && p0[i] == p1[i])
+    i++;
+
+  return i;
+}
+
+/* Return the offset of the first byte at or after offset I where the
+   word-aligned blocks P0 and P1 agree, or LIM if there is no such
+   byte before offset LIM.  */
+
+static idx_t
+find_equal_byte (char const *p0, char const *p1, idx_t i, idx_t lim)
+{
+  while (i < lim && i % sizeof (uintptr_t) != 0 && p0[i] != p1[i])
+    i++;
+
+  /* Skip whole words in which every byte differs, i.e., words whose
+     exclusive OR has no zero byte.  */
+  if (i % sizeof (uintptr_t) == 0)
+    {
+      uintptr_t const ones = UINTPTR_MAX / UCHAR_MAX;
+      uintptr_t const highs = ones << (CHAR_BIT - 1);
+      for (; sizeof (uintptr_t) <= lim - i; i += sizeof (uintptr_t))
+        {
+          uintptr_t w0, w1;
+          memcpy (&w0, p0 + i, sizeof w0);
+          memcpy (&w1, p1 + i, sizeof w1);
+          uintptr_t x = w0 ^ w1;
+          if ((x - ones) & ~x & highs)
+            break;
+        }
+    }
+
+  while (i < lim && p0[i] != p1[i])
+    i++;
+
+  return i;
+}
+
+/* Output the range of differing bytes that starts at byte number
+   START and ends just before byte number END, using WIDTH columns for
+   each number.  */
+
+static void
+print_range (intmax_t start, intmax_t end, int width)
+{
+  printf ("%*"PRIdMAX" %*"PRIdMAX"\n", width, start, width, end);
+}
+
+/* Report that the files named FILE0 and FILE1 first differ at byte
+   number BYTE_NUMBER and line number LINE_NUMBER, where they contain
+   the bytes C0 and C1 respectively.  */
+
+static void
+print_first_difference (char const *file0, char const *file1,
+                        intmax_t byte_number, intmax_t line_number,
+                        unsigned char c0, unsigned char c1)
+{
+  if (!opt_print_bytes)
+    {
+      /* See POSIX for this format.  This message is
+         used only in the POSIX locale, so it need not
+         be translated.  */
+      static char const char_message[] =
+        "%s %s differ: char %"PRIdMAX", line %"PRIdMAX"\n";
+
+      /* The POSIX rationale recommends using the word
+         "byte" outside the POSIX locale.  Some gettext
+         implementations translate even in the POSIX
+         locale if certain other environment variables
+         are set, so use "byte" if a translation is
+         available, or if outside the POSIX locale.  */
+      static char const byte_msgid[] =
+        N_("%s %s differ: byte %"PRIdMAX", line %"PRIdMAX"\n");
+      char const *byte_message = _(byte_msgid);
+      bool use_byte_message = (byte_message != byte_msgid
+                               || hard_locale_LC_MESSAGES ());
+
+      printf (use_byte_message ? byte_message : char_message,
+              file0, file1, byte_number, line_number);
+    }
+  else
+    {
+      char s0[5];
+      char s1[5];
+      sprintc (s0, c0);
+      sprintc (s1, c1);
+      printf (_("%s %s differ: byte %"PRIdMAX", line %"PRIdMAX
+                " is %3o %s %3o %s\n"),
+              file0, file1, byte_number, line_number,
+              c0, s0, c1, s1);
+    }
+}
+
+/* Report that the file named NAME ended just before byte number
+   BYTE_NUMBER, which is in line number LINE_NUMBER.  AT_LINE_START
+   says whether the end is at the start of that line, and WITH_LINE
+   whether to mention the line at all.  */
+
+static void
+print_eof (char const *name, intmax_t byte_number, intmax_t line_number,
+           bool at_line_start, bool with_line)
+{
+  /* POSIX says that each of these format strings must be
+     "cmp: EOF on %s", optionally followed by a blank and
+     extra text sans newline, then terminated by "\n".  */
+  fprintf (stderr,
+           _(byte_number == 1
+             ? N_("cmp: EOF on %s which is empty\n")
+             : !with_line
+             ? N_("cmp: EOF on %s after byte %"PRIdMAX"\n")
+             : at_line_start
+             ? N_("cmp: EOF on %s after byte %"PRIdMAX","
+                  " line %"PRIdMAX"\n")
+             : N_("cmp: EOF on %s after byte %"PRIdMAX","
+                  " in line %"PRIdMAX"\n")),
+           quote (name), byte_number - 1, line_number - at_line_start);
+}
+
 /* Return the number of newlines in BUF, of size BUFSIZE,
    where BUF[NBYTES] is available for use as a sentinel.  */
 
@@ -729,10 +1346,64 @@ file_position (int f)
   if (! positioned[f])
     {
       positioned[f] = true;
-      off_t pos = ignore_initial[f];
-      position[f] = (0 <= pos && pos <= TYPE_MAXIMUM (off_t)
-		     ? lseek (file_desc[f], pos, SEEK_CUR)
-		     : -1);
+      position[f] = seek_initial (file_desc[f], ignore_initial[f]);
     }
   return position[f];
 }
+
+/* Position the file with descriptor DESC to IG bytes from its initial
+   position, and yield its new position.  Return a negative number on
+   failure, or if IG is negative.  */
+
+static off_t
+seek_initial (int desc, intmax_t ig)
+{
+  return (0 <= ig && ig <= TYPE_MAXIMUM (off_t)
+          ? lseek (desc, ig, SEEK_CUR)
+          : -1);
+}
+
+/* Skip the initial IG bytes of the file named NAME with descriptor
+   DESC and status *ST by reading them into BUF, for use when lseek
+   does not suffice.  Return true if the file should be treated as
+   being at its end afterwards.  */
+
+static bool
+skip_initial (int desc, char const *name, struct stat const *st,
+              intmax_t ig, char *buf)
+{
+  if (! (0 <= ig && ig < TYPE_MAXIMUM (off_t))
+      && -1 <= st->st_size && S_ISREG (st->st_mode))
+    {
+      /* When ignoring at least TYPE_MAXIMUM (off_t) bytes
+         of a regular file, pretend to be at end of file,
+         as lseeking to TYPE_MAXIMUM (off_t) might tickle a kernel bug,
+         and lseeking to file end would race with a growing file.  */
+      return true;
+    }
+
+  if (ig < 0)
+    {
+      /* Report an error if asked to ignore more than
+         INTMAX_MAX bytes of a non-regular file,
+         as the actual number of bytes to ignore is not known.  */
+      error (EXIT_TROUBLE, EOVERFLOW, "%s", squote (0, name));
+    }
+
+  /* Read and discard the ignored initial prefix.  */
+  do
+    {
+      idx_t bytes_to_read = MIN (ig, buf_size);
+      ptrdiff_t r = block_read (desc, buf, bytes_to_read);
+      if (r != bytes_to_read)
+        {
+          if (r < 0)
+            error (EXIT_TROUBLE, errno, "%s", squote (0, name));
+          break;
+        }
+      ig -= r;
+    }
+  while (0 < ig);
+
+  return false;
+}
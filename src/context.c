@@ -245,7 +245,7 @@ pr_context_hunk (struct change *hunk)
             }
 	  print_1_line_nl (prefix, &curr.file[0].linbuf[i], true);
           set_color_context (RESET_CONTEXT);
-	  if (curr.file[0].linbuf[i + 1][-1] == '\n')
+	  if (line_is_complete (curr.file[0].linbuf[i + 1]))
             putc ('\n', out);
         }
     }
@@ -283,7 +283,7 @@ pr_context_hunk (struct change *hunk)
             }
 	  print_1_line_nl (prefix, &curr.file[1].linbuf[i], true);
           set_color_context (RESET_CONTEXT);
-	  if (curr.file[1].linbuf[i + 1][-1] == '\n')
+	  if (line_is_complete (curr.file[1].linbuf[i + 1]))
             putc ('\n', out);
         }
     }
@@ -396,7 +396,7 @@ pr_unidiff_hunk (struct change *hunk)
 
               set_color_context (RESET_CONTEXT);
 
-              if (line[1][-1] == '\n')
+              if (line_is_complete (line[1]))
                 putc ('\n', out);
             }
 
@@ -415,7 +415,7 @@ pr_unidiff_hunk (struct change *hunk)
 
               set_color_context (RESET_CONTEXT);
 
-              if (line[1][-1] == '\n')
+              if (line_is_complete (line[1]))
                 putc ('\n', out);
             }
 
@@ -81,6 +81,7 @@ static void summarize_regexp_list (struct regexp_list *);
 static void specify_style (enum output_style);
 static void specify_value (char const **, char const *, char const *);
 static void specify_colors_style (char const *);
+static void specify_metadata_fields (char const *);
 static void check_stdout (void);
 static void usage (void);
 
@@ -124,6 +125,35 @@ static bool report_identical_files;
 
 /* Do not treat directories specially.  */
 static bool no_directory;
+
+/* If nonnull, the file that remembers identical files between runs
+   (--tree-index).  */
+static char const *tree_index;
+
+/* If nonnull, the directory that caches line tables between runs
+   (--line-cache).  */
+static char const *line_cache;
+
+/* Watch the operands for changes and compare again whatever changes
+   (--watch).  */
+static bool watch;
+
+/* The status fields that decide whether regular files are the same,
+   so that they need not be read (--metadata-only), or 0 if their
+   contents are compared as usual.  */
+enum
+{
+  METADATA_SIZE = 1 << 0,
+  METADATA_MTIME = 1 << 1,
+  METADATA_MODE = 1 << 2,
+  METADATA_OWNER = 1 << 3
+};
+static int metadata_fields;
+
+/* Whether options can make files with different contents compare
+   equal, so that finding no differences does not mean the files are
+   identical.  */
+static bool ignoring_differences;
 
 /* Values for long options that do not have single-letter equivalents.  */
 enum
@@ -134,17 +164,26 @@ enum
   HORIZON_LINES_OPTION,
   IGNORE_FILE_NAME_CASE_OPTION,
   INHIBIT_HUNK_MERGE_OPTION,
+  KEY_DELIMITER_OPTION,
+  KEY_FIELDS_OPTION,
   LEFT_COLUMN_OPTION,
+  LINE_CACHE_OPTION,
   LINE_FORMAT_OPTION,
+  METADATA_ONLY_OPTION,
   NO_DEREFERENCE_OPTION,
   NO_IGNORE_FILE_NAME_CASE_OPTION,
   NORMAL_OPTION,
+  PREFETCH_OPTION,
   SDIFF_MERGE_ASSIST_OPTION,
+  SORTED_OPTION,
+  SPLIT_LINES_OPTION,
   STRIP_TRAILING_CR_OPTION,
   SUPPRESS_BLANK_EMPTY_OPTION,
   SUPPRESS_COMMON_LINES_OPTION,
   TABSIZE_OPTION,
   TO_FILE_OPTION,
+  TREE_INDEX_OPTION,
+  WATCH_OPTION,
 
   /* These options must be in sequence.  */
   UNCHANGED_LINE_FORMAT_OPTION,
@@ -208,8 +247,12 @@ static struct option const longopts[] =
   {"inhibit-hunk-merge", 0, 0, INHIBIT_HUNK_MERGE_OPTION},
   {"initial-tab", 0, 0, 'T'},
   {"label", 1, 0, 'L'},
+  {"key-delimiter", 1, 0, KEY_DELIMITER_OPTION},
+  {"key-fields", 1, 0, KEY_FIELDS_OPTION},
   {"left-column", 0, 0, LEFT_COLUMN_OPTION},
+  {"line-cache", 1, 0, LINE_CACHE_OPTION},
   {"line-format", 1, 0, LINE_FORMAT_OPTION},
+  {"metadata-only", 2, 0, METADATA_ONLY_OPTION},
   {"minimal", 0, 0, 'd'},
   {"new-file", 0, 0, 'N'},
   {"new-group-format", 1, 0, NEW_GROUP_FORMAT_OPTION},
@@ -221,6 +264,7 @@ static struct option const longopts[] =
   {"old-line-format", 1, 0, OLD_LINE_FORMAT_OPTION},
   {"paginate", 0, 0, 'l'},
   {"palette", 1, 0, COLOR_PALETTE_OPTION},
+  {"prefetch", 1, 0, PREFETCH_OPTION},
   {"rcs", 0, 0, 'n'},
   {"recursive", 0, 0, 'r'},
   {"report-identical-files", 0, 0, 's'},
@@ -228,7 +272,9 @@ static struct option const longopts[] =
   {"show-c-function", 0, 0, 'p'},
   {"show-function-line", 1, 0, 'F'},
   {"side-by-side", 0, 0, 'y'},
+  {"sorted", 0, 0, SORTED_OPTION},
   {"speed-large-files", 0, 0, 'H'},
+  {"split-lines", 1, 0, SPLIT_LINES_OPTION},
   {"starting-file", 1, 0, 'S'},
   {"strip-trailing-cr", 0, 0, STRIP_TRAILING_CR_OPTION},
   {"suppress-blank-empty", 0, 0, SUPPRESS_BLANK_EMPTY_OPTION},
@@ -236,11 +282,13 @@ static struct option const longopts[] =
   {"tabsize", 1, 0, TABSIZE_OPTION},
   {"text", 0, 0, 'a'},
   {"to-file", 1, 0, TO_FILE_OPTION},
+  {"tree-index", 1, 0, TREE_INDEX_OPTION},
   {"unchanged-group-format", 1, 0, UNCHANGED_GROUP_FORMAT_OPTION},
   {"unchanged-line-format", 1, 0, UNCHANGED_LINE_FORMAT_OPTION},
   {"unidirectional-new-file", 0, 0, 'P'},
   {"unified", 2, 0, 'U'},
   {"version", 0, 0, 'v'},
+  {"watch", 0, 0, WATCH_OPTION},
   {"width", 1, 0, 'W'},
 
   /* This is solely for diff3.  Do not document.  */
@@ -310,6 +358,7 @@ main (int argc, char **argv)
   excluded = new_exclude ();
   presume_output_tty = false;
   xstdopen ();
+  buffer_output (stdout);
 
   /* Parse command line options.  */
 
@@ -630,16 +679,36 @@ main (int argc, char **argv)
 	   compatibility.  */
 	break;
 
+      case KEY_DELIMITER_OPTION:
+	if (!specify_key_delimiter (optarg))
+	  try_help ("invalid key delimiter %s", quote (optarg));
+	break;
+
+      case KEY_FIELDS_OPTION:
+	if (!specify_key_fields (optarg))
+	  try_help ("invalid key field list %s", quote (optarg));
+	compare_by_key = true;
+	break;
+
       case LEFT_COLUMN_OPTION:
 	left_column = true;
 	break;
 
+      case LINE_CACHE_OPTION:
+	specify_value (&line_cache, optarg, "--line-cache");
+	break;
+
       case LINE_FORMAT_OPTION:
 	specify_style (OUTPUT_IFDEF);
 	for (int i = 0; i < sizeof line_format / sizeof line_format[0]; i++)
 	  specify_value (&line_format[i], optarg, "--line-format");
 	break;
 
+      case METADATA_ONLY_OPTION:
+	specify_metadata_fields (optarg);
+	brief = true;
+	break;
+
       case NO_DEREFERENCE_OPTION:
 	no_dereference_symlinks = true;
 	break;
@@ -652,11 +721,31 @@ main (int argc, char **argv)
 	specify_style (OUTPUT_NORMAL);
 	break;
 
+      case PREFETCH_OPTION:
+	{
+	  char *numend;
+	  intmax_t numval = strtoimax (optarg, &numend, 10);
+	  if (*numend || numval < 0)
+	    try_help ("invalid prefetch count %s", quote (optarg));
+	  prefetch_files = MIN (numval, IDX_MAX);
+	}
+	break;
+
       case SDIFF_MERGE_ASSIST_OPTION:
 	specify_style (OUTPUT_SDIFF);
 	sdiff_merge_assist = true;
 	break;
 
+      case SORTED_OPTION:
+	sorted_input = true;
+	break;
+
+      case SPLIT_LINES_OPTION:
+	if (! (optarg[0] && !optarg[1] && optarg[0] != '\n'))
+	  try_help ("invalid line split character %s", quote (optarg));
+	split_char = optarg[0];
+	break;
+
       case STRIP_TRAILING_CR_OPTION:
 	strip_trailing_cr = true;
 	break;
@@ -689,6 +778,14 @@ main (int argc, char **argv)
 	specify_value (&to_file, optarg, "--to-file");
 	break;
 
+      case TREE_INDEX_OPTION:
+	specify_value (&tree_index, optarg, "--tree-index");
+	break;
+
+      case WATCH_OPTION:
+	watch = true;
+	break;
+
       case UNCHANGED_LINE_FORMAT_OPTION:
       case OLD_LINE_FORMAT_OPTION:
       case NEW_LINE_FORMAT_OPTION:
@@ -745,6 +842,22 @@ main (int argc, char **argv)
         specify_style (OUTPUT_NORMAL);
     }
 
+  if (compare_by_key && output_style != OUTPUT_NORMAL)
+    try_help ("--key-fields is incompatible with other output formats",
+	      nullptr);
+
+  if (split_char != '\n')
+    {
+      if (ignore_case || ignore_white_space || compare_by_key)
+	try_help ("--split-lines is incompatible with --key-fields"
+		  " and with ignoring case or white space", nullptr);
+      if (! (output_style == OUTPUT_NORMAL || output_style == OUTPUT_CONTEXT
+	     || output_style == OUTPUT_UNIFIED
+	     || (output_style == OUTPUT_SDIFF && !sdiff_merge_assist)))
+	try_help ("--split-lines is incompatible with this output format",
+		  nullptr);
+    }
+
   if (output_style != OUTPUT_CONTEXT || hard_locale (LC_TIME))
     {
 #if defined STAT_TIMESPEC || defined STAT_TIMESPEC_NS
@@ -831,10 +944,29 @@ main (int argc, char **argv)
            && !*line_format[UNCHANGED]))
      : (output_style != OUTPUT_SDIFF) | suppress_common_lines);
 
-  files_can_be_treated_as_binary =
-    (brief & binary
-     & ~ (ignore_blank_lines | ignore_case | strip_trailing_cr
-          | (ignore_regexp_list.regexps || ignore_white_space)));
+  ignoring_differences =
+    (ignore_blank_lines | ignore_case | strip_trailing_cr | compare_by_key
+     | (ignore_regexp_list.regexps || ignore_white_space
+        || split_char != '\n'));
+
+  files_can_be_treated_as_binary = brief & binary & !ignoring_differences;
+
+  /* Merging sorted files needs lines that are equivalent to sort
+     together in byte order, which options that ignore differences
+     within lines do not ensure.  */
+  if (ignore_case | strip_trailing_cr
+      | (ignore_white_space || split_char != '\n'))
+    sorted_input = false;
+
+  /* Reading files ahead is pointless if they are not read.  */
+  if (metadata_fields)
+    prefetch_files = 0;
+
+  if (tree_index)
+    index_load (tree_index);
+
+  if (line_cache)
+    line_cache_init (line_cache);
 
   switch_string = option_list (argv + 1, optind - 1);
 
@@ -844,6 +976,9 @@ main (int argc, char **argv)
   noparent.file[1].desc = AT_FDCWD;
   static enum detype const de_unknowns[] = {DE_UNKNOWN, DE_UNKNOWN};
 
+  if (watch && (from_file || to_file))
+    fatal ("--watch is incompatible with --from-file and --to-file");
+
   if (from_file)
     {
       if (to_file)
@@ -876,6 +1011,9 @@ main (int argc, char **argv)
               else
 		try_help ("extra operand %s", quote (argv[optind + 2]));
             }
+	  if (watch && (STREQ (argv[optind], "-")
+			|| STREQ (argv[optind + 1], "-")))
+	    fatal ("--watch cannot watch standard input");
 
 	  exit_status = compare_files (&noparent, de_unknowns,
 				       argv[optind], argv[optind + 1]);
@@ -885,6 +1023,12 @@ main (int argc, char **argv)
   /* Print any messages that were saved up for last.  */
   print_message_queue ();
 
+  if (tree_index && !index_save ())
+    exit_status = EXIT_TROUBLE;
+
+  if (watch)
+    watch_files (argv[optind], argv[optind + 1], recursive);
+
   check_stdout ();
   cleanup_signal_handlers ();
   return exit_status;
@@ -999,6 +1143,17 @@ static char const *const option_help_msgid[] = {
      "                                  FILE1 can be a directory"),
   N_("    --to-file=FILE2             compare all operands to FILE2;\n"
      "                                  FILE2 can be a directory"),
+  N_("    --prefetch=NUM              read ahead NUM files in each directory\n"
+     "                                  while comparing directories"),
+  N_("    --tree-index=FILE           remember identical files in FILE, and\n"
+     "                                  skip reading them if unchanged later"),
+  N_("    --metadata-only[=LIST]      treat regular files as the same if their\n"
+     "                                  status fields in LIST agree, without\n"
+     "                                  reading them; LIST is a comma-separated\n"
+     "                                  list of 'size', 'mtime', 'mode' and\n"
+     "                                  'owner' (default 'size,mtime')"),
+  N_("    --watch                     after comparing, wait for files to change\n"
+     "                                  and compare the changed files again"),
   "",
   N_("-i, --ignore-case               ignore case differences in file contents"),
   N_("-E, --ignore-tab-expansion      ignore changes due to tab expansion"),
@@ -1046,6 +1201,13 @@ static char const *const option_help_msgid[] = {
   N_("-d, --minimal            try hard to find a smaller set of changes"),
   N_("    --horizon-lines=NUM  keep NUM lines of the common prefix and suffix"),
   N_("    --speed-large-files  assume large files and many scattered small changes"),
+  N_("    --sorted             assume sorted input, and compare by merging"),
+  N_("    --key-fields=LIST    compare lines as records matched by the key\n"
+     "                           fields in LIST, ignoring their order"),
+  N_("    --key-delimiter=C    use C rather than TAB as the key field delimiter"),
+  N_("    --line-cache=DIR     cache the lines of unchanged files in DIR"),
+  N_("    --split-lines=C      also end lines at each byte C not followed by a\n"
+     "                           newline, to compare parts of long lines"),
   N_("    --color[=WHEN]       color output; WHEN is 'never', 'always', or 'auto';\n"
      "                           plain --color means --color='auto'"),
   N_("    --palette=PALETTE    the colors to use when --color is active; PALETTE is\n"
@@ -1131,7 +1293,54 @@ specify_colors_style (char const *value)
     try_help ("invalid color %s", quote (value));
 }
 
+/* Decide whether regular files are the same by the status fields in
+   the comma-separated LIST, or by size and last-modified time if LIST
+   is null.  */
+static void
+specify_metadata_fields (char const *list)
+{
+  static char const *const field_name[] = { "size", "mtime", "mode", "owner" };
+  enum { n_field_names = sizeof field_name / sizeof *field_name };
+
+  if (!list)
+    {
+      metadata_fields = METADATA_SIZE | METADATA_MTIME;
+      return;
+    }
+
+  metadata_fields = 0;
+  for (char const *p = list; ; p++)
+    {
+      idx_t len = strcspn (p, ",");
+      int i;
+      for (i = 0; i < n_field_names; i++)
+	if (strlen (field_name[i]) == len && memcmp (field_name[i], p, len) == 0)
+	  break;
+      if (i == n_field_names)
+	try_help ("invalid metadata field list %s", quote (list));
+      metadata_fields |= 1 << i;
+      p += len;
+      if (!*p)
+	return;
+    }
+}
+
 
+/* Return true if the regular files with status ST0 and ST1 differ in
+   the fields chosen by --metadata-only.  */
+static bool
+metadata_differs (struct stat const *st0, struct stat const *st1)
+{
+  return (((metadata_fields & METADATA_SIZE)
+	   && st0->st_size != st1->st_size)
+	  || ((metadata_fields & METADATA_MTIME)
+	      && timespec_cmp (get_stat_mtime (st0), get_stat_mtime (st1)) != 0)
+	  || ((metadata_fields & METADATA_MODE)
+	      && st0->st_mode != st1->st_mode)
+	  || ((metadata_fields & METADATA_OWNER)
+	      && (st0->st_uid != st1->st_uid || st0->st_gid != st1->st_gid)));
+}
+
 /* True if PCMP's file F is a directory.  */
 static bool
 dir_p (struct comparison const *pcmp, int f)
@@ -1320,6 +1529,29 @@ compare_prepped_files (struct comparison const *parent,
       return EXIT_FAILURE;
     }
 
+  /* With --metadata-only, decide whether regular files differ from
+     their status alone.  A file that does not exist is like an empty
+     file, so then only sizes matter.  Standard input has no useful
+     status, so its contents are compared as usual.  */
+  if (metadata_fields
+      && S_ISREG (cmp->file[0].stat.st_mode)
+      && S_ISREG (cmp->file[1].stat.st_mode)
+      && cmp->file[0].desc != STDIN_FILENO
+      && cmp->file[1].desc != STDIN_FILENO)
+    {
+      bool differ
+	= (cmp->file[0].desc == NONEXISTENT
+	   || cmp->file[1].desc == NONEXISTENT
+	   ? cmp->file[0].stat.st_size != cmp->file[1].stat.st_size
+	   : metadata_differs (&cmp->file[0].stat, &cmp->file[1].stat));
+      if (!differ)
+	return EXIT_SUCCESS;
+      message ("Files %s and %s differ\n",
+	       file_label[0] ? file_label[0] : squote (0, cmp->file[0].name),
+	       file_label[1] ? file_label[1] : squote (1, cmp->file[1].name));
+      return EXIT_FAILURE;
+    }
+
   if (files_can_be_treated_as_binary
       && S_ISREG (cmp->file[0].stat.st_mode)
       && S_ISREG (cmp->file[1].stat.st_mode)
@@ -1333,6 +1565,16 @@ compare_prepped_files (struct comparison const *parent,
       return EXIT_FAILURE;
     }
 
+  /* Regular files that an earlier run found to be identical are still
+     identical if neither has changed since.  */
+  bool indexable = (tree_index && no_diff_means_no_output
+		    && S_ISREG (cmp->file[0].stat.st_mode)
+		    && S_ISREG (cmp->file[1].stat.st_mode)
+		    && cmp->file[0].desc != STDIN_FILENO
+		    && cmp->file[1].desc != STDIN_FILENO);
+  if (indexable && index_lookup (cmp))
+    return EXIT_SUCCESS;
+
   /* Both files exist and neither is a directory or a symbolic link.
      Open the files and record their descriptors,
      if they are not already open.  */
@@ -1367,7 +1609,10 @@ compare_prepped_files (struct comparison const *parent,
 
   if (status != EXIT_SUCCESS)
     return status;
-  return diff_2_files (cmp);
+  status = diff_2_files (cmp);
+  if (indexable && status == EXIT_SUCCESS && !ignoring_differences)
+    index_record (cmp);
+  return status;
 }
 
 
@@ -1469,7 +1714,8 @@ compare_files (struct comparison const *parent, enum detype const detype[2],
 	  if (binary && ! isatty (fd))
 	    set_binary_mode (fd, O_BINARY);
 	}
-      else if (toplevel || detype[f] == DE_REG || detype[f] == DE_DIR
+      else if (toplevel || (detype[f] == DE_REG && !metadata_fields)
+	       || detype[f] == DE_DIR
 	       || (O_PATH_DEFINED && detype[f] == DE_LNK
 		   && no_dereference_symlinks))
 	{
@@ -1477,7 +1723,8 @@ compare_files (struct comparison const *parent, enum detype const detype[2],
 	     or the file is known to be a type that is
 	     safe to open and is likely to be opened anyway.
 	     Open the file now, as openat+fstat avoids an fstatat+openat race
-	     and might be a bit faster.  */
+	     and might be a bit faster.  With --metadata-only, regular
+	     files below the top level are not read, so just stat them.  */
 	  int accmode = ((O_PATH_DEFINED && !toplevel && detype[f] == DE_LNK
 			  && no_dereference_symlinks)
 			 ? O_PATHSEARCH : O_RDONLY);
@@ -1669,6 +1916,7 @@ compare_files (struct comparison const *parent, enum detype const detype[2],
 /* Define variables declared in diff.h (which see).  */
 FILE *outfile;
 bool brief;
+bool compare_by_key;
 bool expand_tabs;
 bool files_can_be_treated_as_binary;
 bool ignore_blank_lines;
@@ -1682,6 +1930,7 @@ bool no_diff_means_no_output;
 bool paginate;
 bool presume_output_tty;
 bool sdiff_merge_assist;
+bool sorted_input;
 bool speed_large_files;
 bool strip_trailing_cr;
 bool suppress_blank_empty;
@@ -1693,9 +1942,11 @@ char const *group_format[CHANGED + 1];
 char const *line_format[NEW + 1];
 char const *starting_file;
 char const *time_format;
+char split_char = '\n';
 enum DIFF_white_space ignore_white_space;
 enum colors_style colors_style;
 enum output_style output_style;
+idx_t prefetch_files;
 intmax_t sdiff_column2_offset;
 intmax_t sdiff_half_width;
 intmax_t tabsize;
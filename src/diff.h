@@ -239,6 +239,31 @@ extern struct exclude *excluded;
    slower) but will find a guaranteed minimal set of changes.  */
 extern bool minimal;
 
+/* Assume the input files are sorted in byte order, and compare them
+   by merging rather than by the usual algorithm (--sorted).  */
+extern bool sorted_input;
+
+/* Compare files as sets of records matched by key fields
+   (--key-fields).  */
+extern bool compare_by_key;
+
+/* A byte that also ends lines (--split-lines), unless a newline
+   follows it, or '\n' if only newlines end lines.  */
+extern char split_char;
+
+/* Return true if the line that ends just before LIMIT is complete,
+   so that a newline follows it in output: either it ends in a
+   newline, or it is a piece of a line split by --split-lines.  */
+DIFF_INLINE bool line_is_complete (char const *limit)
+{
+  return (limit[-1] == '\n'
+	  || (limit[-1] == split_char && *limit != '\n'));
+}
+
+/* When comparing directories, the number of files after the current
+   one in each directory to prefetch (--prefetch).  */
+extern idx_t prefetch_files;
+
 /* The strftime format to use for time strings.  */
 extern char const *time_format;
 
@@ -352,6 +377,9 @@ struct file_data {
     /* 1 if file ends in a line with no final newline.  */
     bool missing_newline;
 
+    /* 1 if --sorted was given but the hashed lines are out of order.  */
+    bool unsorted;
+
     /* 1 if at end of file.  */
     bool eof;
 
@@ -421,9 +449,52 @@ extern void pr_forward_ed_script (struct change *);
 /* ifdef.c */
 extern void print_ifdef_script (struct change *);
 
+/* index.c */
+extern void index_load (char const *);
+extern bool index_lookup (struct comparison const *);
+extern void index_record (struct comparison const *);
+extern bool index_save (void);
+
 /* io.c */
 extern void file_block_read (struct file_data *, idx_t);
 extern bool read_files (struct file_data[], bool);
+extern bool stream_files (struct file_data[], int *);
+extern int compare_line_bytes (char const *, idx_t, char const *, idx_t);
+
+/* linecache.c */
+
+/* The lines of a whole file and their hashes.  */
+struct line_table
+{
+  /* The number of lines.  */
+  lin nlines;
+
+  /* The offsets of the starts of the lines, followed by the offset of
+     the end of the last line.  */
+  idx_t *offsets;
+
+  /* The hash of each line.  */
+  size_t *hashes;
+
+  /* If nonnull, the storage holding OFFSETS and HASHES, as loaded from
+     the cache.  */
+  void *data;
+};
+
+/* The version of the unkeyed line hashes in io.c, which line caches
+   record.  Increment this whenever those hashes change.  */
+enum { LINE_HASH_VERSION = 1 };
+
+extern char const *line_cache_dir;
+extern void line_cache_init (char const *);
+extern bool line_cache_load (struct file_data const *, struct line_table *);
+extern void line_cache_save (struct file_data const *,
+			     struct line_table const *);
+
+/* keyed.c */
+extern bool specify_key_fields (char const *);
+extern bool specify_key_delimiter (char const *);
+extern int diff_keyed_records (struct comparison *);
 
 /* normal.c */
 extern void print_normal_script (struct change *);
@@ -434,14 +505,19 @@ extern void print_rcs_script (struct change *);
 /* side.c */
 extern void print_sdiff_script (struct change *);
 
+/* watch.c */
+extern _Noreturn void watch_files (char const *, char const *, bool);
+
 /* util.c */
 extern char const change_letter[4];
 extern char const pr_program[];
 extern lin translate_line_number (struct file_data const *, lin)
   ATTRIBUTE_PURE;
 extern struct change *find_change (struct change *) ATTRIBUTE_CONST;
+extern void advise_huge_pages (void *, idx_t);
 extern enum changes analyze_hunk (struct change *, lin *, lin *, lin *, lin *);
 extern void begin_output (void);
+extern void buffer_output (FILE *);
 extern void cleanup_signal_handlers (void);
 extern void debug_script (struct change *);
 extern _Noreturn void fatal (char const *);
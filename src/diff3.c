@@ -98,6 +98,25 @@ struct diff3_block {
   struct diff3_block *next;
 };
 
+/* A reader of the output of a subsidiary diff.  The output is parsed
+   as it is read, in chunks that are never moved or freed once read,
+   so that diff blocks can point into them.  Only the incomplete line
+   at the end of a full arena is copied, into the next arena.  */
+struct diff_reader {
+  int fd;			/* Pipe from the subsidiary diff */
+#if HAVE_WORKING_FORK
+  pid_t pid;			/* The subsidiary diff, or -1 if not spawned */
+  int spawn_errno;		/* Why the subsidiary diff was not spawned */
+#else
+  FILE *fpipe;
+#endif
+  char *pos;			/* The next byte to parse */
+  char *lim;			/* The end of the data read so far */
+  char *arena_lim;		/* The end of the current arena */
+  idx_t chunk_size;		/* The usual size of an arena */
+  bool eof;			/* True if the pipe has reached EOF */
+};
+
 /* The following are macros, not functions, as they may be used as
    lvalues, or they may be polymorphic in that they work with either
    diff or diff3 blocks.  */
@@ -177,8 +196,12 @@ static bool finalwrite;
 /* If nonzero, output a merged file.  */
 static bool merge;
 
-static char *read_diff (char const *, char const *, char **);
-static char *scan_diff_line (char *, char **, idx_t *, char *, char);
+static void open_diff (struct diff_reader *, char const *, char const *);
+static char *next_diff_line (struct diff_reader *);
+static void close_diff (struct diff_reader *);
+static void reap_failed_diff (struct diff_reader *);
+static _Noreturn void diff_format_error (struct diff_reader *, char const *);
+static void scan_diff_line (struct diff_reader *, char **, idx_t *, char);
 static enum diff_type process_diff_control (char **, struct diff_block *);
 static bool compare_line_list (char *const[], idx_t const[],
 			       char *const[], idx_t const[], lin);
@@ -909,10 +932,10 @@ process_diff (char const *filea, char const *fileb)
   struct diff_block *block_list;
   struct diff_block **block_list_end = &block_list;
 
-  char *scan_diff;
-  char *diff_limit = read_diff (filea, fileb, &scan_diff);
+  struct diff_reader reader;
+  open_diff (&reader, filea, fileb);
 
-  while (scan_diff < diff_limit)
+  for (char *scan_diff; (scan_diff = next_diff_line (&reader)); )
     {
       struct diff_block *bptr = xmalloc (sizeof *bptr);
       bptr->lines[0] = bptr->lines[1] = nullptr;
@@ -921,6 +944,7 @@ process_diff (char const *filea, char const *fileb)
       enum diff_type dt = process_diff_control (&scan_diff, bptr);
       if (dt == DIFF_ERROR || *scan_diff != '\n')
         {
+          reap_failed_diff (&reader);
 	  fprintf (stderr, _("%s: diff failed: "), squote (0, program_name));
           do
             {
@@ -929,7 +953,6 @@ process_diff (char const *filea, char const *fileb)
           while (*scan_diff++ != '\n');
           exit (EXIT_TROUBLE);
         }
-      scan_diff++;
 
       /* Force appropriate ranges to be null, if necessary */
       switch (dt)
@@ -955,19 +978,17 @@ process_diff (char const *filea, char const *fileb)
           bptr->lines[0] = xinmalloc (numlines, sizeof *bptr->lines[0]);
           bptr->lengths[0] = xinmalloc (numlines, sizeof *bptr->lengths[0]);
           for (lin i = 0; i < numlines; i++)
-            scan_diff = scan_diff_line (scan_diff,
-                                        &(bptr->lines[0][i]),
-                                        &(bptr->lengths[0][i]),
-                                        diff_limit,
-                                        '<');
+            scan_diff_line (&reader, &(bptr->lines[0][i]),
+                            &(bptr->lengths[0][i]), '<');
         }
 
       /* Get past the separator for changes */
       if (dt == DIFF_CHANGE)
         {
-          if (strncmp (scan_diff, "---\n", 4))
-            fatal ("invalid diff format; invalid change separator");
-          scan_diff += 4;
+          scan_diff = next_diff_line (&reader);
+          if (! scan_diff || strncmp (scan_diff, "---\n", 4))
+            diff_format_error (&reader,
+                               "invalid diff format; invalid change separator");
         }
 
       /* Allocate space for the pointers for the lines from fileb, and
@@ -978,11 +999,8 @@ process_diff (char const *filea, char const *fileb)
           bptr->lines[1] = xinmalloc (numlines, sizeof *bptr->lines[1]);
           bptr->lengths[1] = xinmalloc (numlines, sizeof *bptr->lengths[1]);
           for (lin i = 0; i < numlines; i++)
-            scan_diff = scan_diff_line (scan_diff,
-                                        &(bptr->lines[1][i]),
-                                        &(bptr->lengths[1][i]),
-                                        diff_limit,
-                                        '>');
+            scan_diff_line (&reader, &(bptr->lines[1][i]),
+                            &(bptr->lengths[1][i]), '>');
         }
 
       /* Place this block on the blocklist.  */
@@ -991,6 +1009,7 @@ process_diff (char const *filea, char const *fileb)
     }
 
   *block_list_end = nullptr;
+  close_diff (&reader);
   return block_list;
 }
 
@@ -1102,10 +1121,10 @@ process_diff_control (char **string, struct diff_block *db)
   return type;
 }
 
-static char *
-read_diff (char const *filea,
-           char const *fileb,
-           char **output_placement)
+/* Start a subsidiary diff of FILEA and FILEB, to be read by READER.  */
+
+static void
+open_diff (struct diff_reader *reader, char const *filea, char const *fileb)
 {
   char const *argv[10];
   char const **ap = argv;
@@ -1127,90 +1146,142 @@ read_diff (char const *filea,
   if (pipe (fds) != 0)
     perror_with_exit ("pipe");
 
-  pid_t pid = fork ();
-  if (pid == 0)
-    {
-      /* Child */
-      close (fds[0]);
-      if (fds[1] != STDOUT_FILENO)
-        {
-          dup2 (fds[1], STDOUT_FILENO);
-          close (fds[1]);
-        }
-
-      /* The cast to (char **) is needed for portability to older
-         hosts with a nonstandard prototype for execvp.  */
-      execvp (diff_program, (char **) argv);
-
-      _exit (errno == ENOENT ? 127 : 126);
-    }
-
-  if (pid == -1)
-    perror_with_exit ("fork");
+  reader->pid = spawn_program (diff_program, argv, true,
+			       fds[1], STDOUT_FILENO, fds[0], nullptr);
+  reader->spawn_errno = reader->pid < 0 ? errno : 0;
 
   close (fds[1]);		/* Prevent erroneous lack of EOF */
-  int fd = fds[0];
+  reader->fd = fds[0];
 
 #else
 
   char *command = system_quote_argv (SCI_SYSTEM, (char **) argv);
   errno = 0;
-  FILE *fpipe = popen (command, "r");
-  if (!fpipe)
+  reader->fpipe = popen (command, "r");
+  if (!reader->fpipe)
     perror_with_exit (command);
   free (command);
-  int fd = fileno (fpipe);
+  reader->fd = fileno (reader->fpipe);
 
 #endif
 
+  /* Use arenas at least as large as a typical pipe buffer, so that
+     few lines straddle arenas.  */
   struct stat pipestat;
-  idx_t current_chunk_size;
-  if (fstat (fd, &pipestat) < 0
-      || STAT_BLOCKSIZE (pipestat) <= 0
-      || ckd_add (&current_chunk_size, STAT_BLOCKSIZE (pipestat), 0))
-    current_chunk_size = 8 * 1024;
-  char *diff_result = ximalloc (current_chunk_size);
-  idx_t total = 0;
-
-  for (;;)
+  if (fstat (reader->fd, &pipestat) < 0
+      || STAT_BLOCKSIZE (pipestat) <= 64 * 1024
+      || ckd_add (&reader->chunk_size, STAT_BLOCKSIZE (pipestat), 0))
+    reader->chunk_size = 64 * 1024;
+  reader->pos = reader->lim = reader->arena_lim = nullptr;
+  reader->eof = false;
+}
+
+/* Read more of the subsidiary diff's output into READER, or set
+   READER->eof if there is no more.  */
+
+static void
+read_diff_chunk (struct diff_reader *reader)
+{
+  if (reader->lim == reader->arena_lim)
     {
-      idx_t bytes_to_read = current_chunk_size - total;
-      ptrdiff_t bytes = block_read (fd, diff_result + total, bytes_to_read);
-      total += bytes;
-      if (bytes != bytes_to_read)
-        {
-          if (bytes < 0)
-            perror_with_exit (_("read failed"));
-          break;
-        }
-      diff_result = xpalloc (diff_result, &current_chunk_size, 1, -1, 1);
+      /* Start a new arena, and move the unparsed tail of the old one
+	 into it.  Grow the arena size if the tail is large, so that a
+	 long line is not copied many times.  */
+      idx_t tail = reader->lim - reader->pos;
+      idx_t size = reader->chunk_size;
+      if (size / 2 < tail && ckd_mul (&size, tail, 2))
+	xalloc_die ();
+      char *arena = ximalloc (size);
+      if (tail)
+	memcpy (arena, reader->pos, tail);
+      reader->pos = arena;
+      reader->lim = arena + tail;
+      reader->arena_lim = arena + size;
+    }
+
+  ptrdiff_t bytes = read (reader->fd, reader->lim,
+			  MIN (reader->arena_lim - reader->lim, SSIZE_MAX));
+  if (bytes < 0)
+    perror_with_exit (_("read failed"));
+  reader->lim += bytes;
+  reader->eof = bytes == 0;
+}
+
+/* Return the next line of the subsidiary diff's output in READER,
+   and advance past it.  The line ends in a newline and stays in
+   memory.  Return a null pointer at the end of the output.  */
+
+static char *
+next_diff_line (struct diff_reader *reader)
+{
+  idx_t scanned = 0;
+  char *nl;
+  while (! (nl = memchr (reader->pos + scanned, '\n',
+			 reader->lim - reader->pos - scanned)))
+    {
+      scanned = reader->lim - reader->pos;
+      if (reader->eof)
+	{
+	  if (scanned)
+	    diff_format_error (reader,
+			       "invalid diff format; incomplete last line");
+	  return nullptr;
+	}
+      read_diff_chunk (reader);
     }
 
-  if (total != 0 && diff_result[total-1] != '\n')
-    fatal ("invalid diff format; incomplete last line");
+  char *line = reader->pos;
+  reader->pos = nl + 1;
+  return line;
+}
+
+/* Return the next byte of the subsidiary diff's output in READER
+   without advancing past it, or EOF if there are no more.  */
+
+static int
+peek_diff_byte (struct diff_reader *reader)
+{
+  while (reader->pos == reader->lim)
+    {
+      if (reader->eof)
+	return EOF;
+      read_diff_chunk (reader);
+    }
+  return (unsigned char) *reader->pos;
+}
 
-  *output_placement = diff_result;
+/* Finish reading from the subsidiary diff of READER, whose output
+   has all been parsed, and report any trouble it had.  */
 
+static void
+close_diff (struct diff_reader *reader)
+{
   int werrno = 0;
   int wstatus;
+  int status;
 #if ! HAVE_WORKING_FORK
 
-  wstatus = pclose (fpipe);
+  wstatus = pclose (reader->fpipe);
   if (wstatus == -1)
     werrno = errno;
+  status = (! werrno && WIFEXITED (wstatus)
+            ? WEXITSTATUS (wstatus) : INT_MAX);
 
 #else
 
-  if (close (fd) != 0)
+  if (close (reader->fd) != 0)
     perror_with_exit ("close");
-  if (waitpid (pid, &wstatus, 0) < 0)
-    perror_with_exit ("waitpid");
+  if (reader->pid < 0)
+    status = spawn_failure_status (reader->spawn_errno);
+  else
+    {
+      if (waitpid (reader->pid, &wstatus, 0) < 0)
+        perror_with_exit ("waitpid");
+      status = WIFEXITED (wstatus) ? WEXITSTATUS (wstatus) : INT_MAX;
+    }
 
 #endif
 
-  int status = (! werrno && WIFEXITED (wstatus)
-                ? WEXITSTATUS (wstatus) : INT_MAX);
-
   if (EXIT_TROUBLE <= status)
     error (EXIT_TROUBLE, werrno,
            _(status == 126
@@ -1221,50 +1292,69 @@ read_diff (char const *filea,
 	     ? "subsidiary program %s failed"
 	     : "subsidiary program %s failed (exit status %d)"),
 	   quote (diff_program), status);
+}
 
-  return diff_result + total;
+
+/* Finish reading from the subsidiary diff of READER, whose output
+   could not be parsed.  If the subsidiary diff failed, report that,
+   as it is likely why its output is bad.  */
+
+static void
+reap_failed_diff (struct diff_reader *reader)
+{
+  /* Read the rest of the output, so that the subsidiary diff is not
+     killed by SIGPIPE and its own exit status can be checked.  */
+  char buf[8 * 1024];
+  while (0 < read (reader->fd, buf, sizeof buf))
+    continue;
+  close_diff (reader);
 }
 
+/* Report that the output of the subsidiary diff of READER is invalid
+   as described by MSGID, unless the subsidiary diff failed.  */
+
+static void
+diff_format_error (struct diff_reader *reader, char const *msgid)
+{
+  reap_failed_diff (reader);
+  fatal (msgid);
+}
 
 /* Scan a regular diff line (consisting of > or <, followed by a
-   space, followed by text (including nulls) up to a newline.
+   space, followed by text (including nulls) up to a newline) from
+   READER.
 
    This next routine began life as a macro and many parameters in it
    are used as call-by-reference values.  */
-static char *
-scan_diff_line (char *scan_ptr, char **set_start, idx_t *set_length,
-                char *limit, char leadingchar)
+static void
+scan_diff_line (struct diff_reader *reader, char **set_start,
+                idx_t *set_length, char leadingchar)
 {
-  if (!(scan_ptr[0] == leadingchar
+  char *scan_ptr = next_diff_line (reader);
+  if (!(scan_ptr
+        && scan_ptr[0] == leadingchar
         && scan_ptr[1] == ' '))
-    fatal ("invalid diff format; incorrect leading line chars");
+    diff_format_error (reader,
+                       "invalid diff format; incorrect leading line chars");
 
-  char *line_ptr = *set_start = scan_ptr + 2;
-  while (*line_ptr++ != '\n')
-    continue;
+  *set_start = scan_ptr + 2;
 
   /* Include newline if the original line ended in a newline,
      or if an edit script is being generated.
      Copy any missing newline message to stderr if an edit script is being
-     generated, because edit scripts cannot handle missing newlines.
-     Return the beginning of the next line.  */
-  *set_length = line_ptr - *set_start;
-  if (line_ptr < limit && *line_ptr == '\\')
+     generated, because edit scripts cannot handle missing newlines.  */
+  *set_length = reader->pos - *set_start;
+  if (peek_diff_byte (reader) == '\\')
     {
+      char *line_ptr = next_diff_line (reader) + 1;
       if (edscript)
-	fprintf (stderr, "%s:", squote (0, program_name));
+	{
+	  fprintf (stderr, "%s:", squote (0, program_name));
+	  fwrite (line_ptr, 1, reader->pos - line_ptr, stderr);
+	}
       else
         --*set_length;
-      line_ptr++;
-      do
-        {
-          if (edscript)
-            putc (*line_ptr, stderr);
-        }
-      while (*line_ptr++ != '\n');
     }
-
-  return line_ptr;
 }
 
 /* Output a three way diff passed as a list of diff3_block's.  The
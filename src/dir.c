@@ -24,6 +24,7 @@
 #include <dirname.h>
 #include <error.h>
 #include <exclude.h>
+#include <fadvise.h>
 #include <filenamecat.h>
 #include <mcel.h>
 #include <quote.h>
@@ -43,6 +44,19 @@ struct dirdata
   idx_t nnames;	/* Number of names.  */
   char const **names;	/* Sorted names of files in dir, followed by 0.  */
   char *data;	/* Allocated storage for file names.  */
+
+  /* With --ignore-file-name-case, KEYS[I] is the case-folded key of
+     NAMES[I], and KEYDATA is the allocated storage for the keys.
+     Otherwise both are null.  */
+  char32_t const **keys;
+  char32_t *keydata;
+};
+
+/* A file name and its case-folded key, for sorting.  */
+struct folded_name
+{
+  char32_t const *key;
+  char const *name;
 };
 
 /* Whether file names in directories should be compared with
@@ -79,6 +93,8 @@ dir_read (int parentdirfd, struct file_data *dir, struct dirdata *dirdata,
 
   dirdata->names = nullptr;
   dirdata->data = nullptr;
+  dirdata->keys = nullptr;
+  dirdata->keydata = nullptr;
 
   if (dir->desc != NONEXISTENT)
     {
@@ -215,6 +231,98 @@ compare_names (char const *name1, char const *name2)
   return file_name_cmp (name1, name2);
 }
 
+/* Store into KEY the case-folded key of NAME, and return a pointer
+   just past the key's terminating zero.  KEY must have room for
+   strlen (NAME) + 1 characters.  Each character is folded with
+   c32tolower, and each encoding error byte B is represented by
+   MCEL_CHAR_MAX + B so that it sorts after all characters; this makes
+   comparing keys with compare_keys equivalent to comparing names with
+   mbscasecmp, without decoding the names again.  */
+
+static char32_t *
+fold_name (char32_t *key, char const *name)
+{
+  for (mcel_t g; ; name += g.len)
+    {
+      g = mcel_scanz (name);
+      *key++ = g.err ? MCEL_CHAR_MAX + g.err : c32tolower (g.ch);
+      if (!g.ch && !g.err)
+        return key;
+    }
+}
+
+/* Compare case-folded keys, returning a value compatible with strcmp.  */
+
+static int
+compare_keys (char32_t const *key1, char32_t const *key2)
+{
+  for (; *key1 == *key2; key1++, key2++)
+    if (!*key1)
+      return 0;
+  return *key1 < *key2 ? -1 : 1;
+}
+
+/* Compare folded names FILE1 and FILE2 when sorting a directory.
+   Compare keys, breaking ties with file_name_cmp so that names that
+   differ only in case are adjacent and in file_name_cmp order.  */
+
+static int
+compare_folded_names_for_qsort (void const *file1, void const *file2)
+{
+  struct folded_name const *f1 = file1;
+  struct folded_name const *f2 = file2;
+  int diff = compare_keys (f1->key, f2->key);
+  return diff ? diff : file_name_cmp (f1->name, f2->name);
+}
+
+/* Sort the names of DIRDATA by their case-folded keys, recording the
+   keys in DIRDATA.  */
+
+static void
+sort_folded_names (struct dirdata *dirdata)
+{
+  idx_t nnames = dirdata->nnames;
+  char const **names = dirdata->names;
+
+  idx_t keylen = 0;
+  for (idx_t i = 0; i < nnames; i++)
+    keylen += strlen (names[i]) + 1;
+  char32_t *key = dirdata->keydata = xinmalloc (keylen, sizeof *key);
+
+  struct folded_name *folded = xinmalloc (nnames, sizeof *folded);
+  for (idx_t i = 0; i < nnames; i++)
+    {
+      folded[i].key = key;
+      folded[i].name = names[i];
+      key = fold_name (key, names[i]);
+    }
+
+  qsort (folded, nnames, sizeof *folded, compare_folded_names_for_qsort);
+
+  char32_t const **keys = xinmalloc (nnames + 1, sizeof *keys);
+  for (idx_t i = 0; i < nnames; i++)
+    {
+      keys[i] = folded[i].key;
+      names[i] = folded[i].name;
+    }
+  keys[nnames] = nullptr;
+  dirdata->keys = keys;
+  free (folded);
+}
+
+/* Compare the names N0 and N1 of DIRDATA[0] and DIRDATA[1] when
+   merging directories, returning a value compatible with strcmp.  */
+
+static int
+compare_dir_names (struct dirdata const dirdata[2],
+                   char const *const *n0, char const *const *n1)
+{
+  return (dirdata[0].keys
+          ? compare_keys (dirdata[0].keys[n0 - dirdata[0].names],
+                          dirdata[1].keys[n1 - dirdata[1].names])
+          : compare_names (*n0, *n1));
+}
+
 /* Compare names FILE1 and FILE2 when sorting a directory.
    Prefer filtered comparison, breaking ties with file_name_cmp.  */
 
@@ -226,6 +334,45 @@ compare_names_for_qsort (void const *file1, void const *file2)
   return compare_names (*f1, *f2);
 }
 
+/* Tell the system that the file NAME in the directory DIRFD will
+   probably be read soon, so that it can read the file while other
+   files are being compared.  Do nothing if NAME is not a nonempty
+   regular file.  Read ahead at most PREFETCH_MAX bytes, so that
+   large files do not push earlier prefetches out of memory.  */
+
+enum { PREFETCH_MAX = 1024 * 1024 };
+
+static void
+prefetch_file (int dirfd, char const *name)
+{
+  if (HAVE_STRUCT_DIRENT_D_TYPE
+      && ! (name[-1] == DE_REG || name[-1] == DE_UNKNOWN
+	    || (name[-1] == DE_LNK && !no_dereference_symlinks)))
+    return;
+
+  /* Do not open a file that is not known to be regular, as opening
+     a special file like a FIFO or a tape drive can have effects.  */
+  if (! (HAVE_STRUCT_DIRENT_D_TYPE && name[-1] == DE_REG))
+    {
+      struct stat st;
+      if (! (fstatat (dirfd, name, &st,
+		      no_dereference_symlinks ? AT_SYMLINK_NOFOLLOW : 0) == 0
+	     && S_ISREG (st.st_mode) && 0 < st.st_size))
+	return;
+    }
+
+  int fd = openat (dirfd, name,
+		   (O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK
+		    | (no_dereference_symlinks ? O_NOFOLLOW : 0)));
+  if (0 <= fd)
+    {
+      struct stat st;
+      if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && 0 < st.st_size)
+	fdadvise (fd, 0, MIN (st.st_size, PREFETCH_MAX), FADVISE_WILLNEED);
+      close (fd);
+    }
+}
+
 /* Compare the contents of two directories named in CMP.
    This is a top-level routine; it does everything necessary for diff
    on two directories.
@@ -267,35 +414,59 @@ diff_dirs (struct comparison *cmp)
 	if (setjmp (failed_locale_specific_sorting))
 	  locale_specific_sorting = false;
 
-      /* Sort the directories.  */
+      /* Sort the directories.  When ignoring file name case, fold
+         each name only once rather than in every comparison.  */
       for (int i = 0; i < 2; i++)
-        qsort (dirdata[i].names, dirdata[i].nnames, sizeof *dirdata[i].names,
-               compare_names_for_qsort);
+        if (ignore_file_name_case)
+          sort_folded_names (&dirdata[i]);
+        else
+          qsort (dirdata[i].names, dirdata[i].nnames,
+                 sizeof *dirdata[i].names, compare_names_for_qsort);
 
       /* Loop while files remain in one or both dirs.  */
       char const **n0 = dirdata[0].names;
       char const **n1 = dirdata[1].names;
+      char const **prefetched[2] = { n0, n1 };
       while (*n0 || *n1)
         {
+          /* Prefetch the files that follow the next ones to be
+             compared, unless they have been prefetched already.  */
+          for (int i = 0; i < 2; i++)
+            if (0 <= cmp->file[i].desc)
+              {
+                char const **n = i ? n1 : n0;
+                if (*n && prefetched[i] <= n)
+                  prefetched[i] = n + 1;
+                for (; *prefetched[i] && prefetched[i] - n <= prefetch_files;
+                     prefetched[i]++)
+                  prefetch_file (cmp->file[i].desc, *prefetched[i]);
+              }
+
           /* Compare next name in dir 0 with next name in dir 1.
              At the end of a dir,
              pretend the "next name" in that dir is very large.  */
-          int nameorder = !*n0 ? 1 : !*n1 ? -1 : compare_names (*n0, *n1);
+          int nameorder = (!*n0 ? 1 : !*n1 ? -1
+                           : compare_dir_names (dirdata, n0, n1));
 
           /* Prefer a file_name_cmp match if available.  This algorithm is
              O(N**2), where N is the number of names in a directory
-             that compare_names says are all equal, but in practice N
-             is so small it's not worth tuning.  */
+             whose keys are all equal, but in practice N is so small
+             it's not worth tuning.  Names with equal keys are sorted
+             by file_name_cmp, so the search can stop early.  */
           if (nameorder == 0 && ignore_file_name_case)
             {
               int raw_order = file_name_cmp (*n0, *n1);
               if (raw_order != 0)
                 {
-                  char const **lesser = raw_order < 0 ? n0 : n1;
-                  char const *greater_name = *(raw_order < 0 ? n1 : n0);
+                  int l = 0 < raw_order;
+                  char const **lesser = l ? n1 : n0;
+                  char const *greater_name = *(l ? n0 : n1);
+                  char32_t const *const *lesser_key
+                    = &dirdata[l].keys[lesser - dirdata[l].names];
 
                   for (char const **p = lesser + 1;
-                       *p && compare_names (*p, greater_name) == 0;
+                       *p && compare_keys (lesser_key[p - lesser],
+                                           *lesser_key) == 0;
                        p++)
                     {
                       int c = file_name_cmp (*p, greater_name);
@@ -328,6 +499,8 @@ diff_dirs (struct comparison *cmp)
     {
       free (dirdata[i].names);
       free (dirdata[i].data);
+      free (dirdata[i].keys);
+      free (dirdata[i].keydata);
     }
 
   return val;
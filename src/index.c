@@ -0,0 +1,290 @@
+/* Remember identical files between runs of GNU DIFF.
+
+   Copyright (C) 2024 Free Software Foundation, Inc.
+
+   This file is part of GNU DIFF.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* A tree index (--tree-index=FILE) records pairs of regular files
+   that were found to have identical contents, together with enough
+   of each file's status to tell whether it has changed since.  A later
+   run that meets the same pair, with neither file changed, can then
+   report the files as identical without reading them.  So that the
+   index does not grow without bound as files are removed or renamed,
+   each run keeps only the pairs that it found to be identical.
+
+   Each line of the index describes one pair, as two groups of seven
+   decimal integers: device, inode, size, modification time in seconds
+   and nanoseconds, and status change time in seconds and nanoseconds.  */
+
+#include "diff.h"
+
+#include <diagnose.h>
+#include <error.h>
+#include <xalloc.h>
+
+/* The status of a regular file, as far as the index is concerned.  */
+struct stamp
+{
+  uintmax_t dev;
+  uintmax_t ino;
+  intmax_t size;
+  struct timespec mtime;
+  struct timespec ctime;
+};
+
+/* A pair of files found to be identical.  */
+struct entry
+{
+  struct stamp file[2];
+
+  /* True if this run found both files unchanged since the entry was
+     made, or made the entry, so that the entry should be kept.  */
+  bool confirmed;
+};
+
+/* The name of the index file.  */
+static char const *index_name;
+
+/* The entries read from the index, sorted by compare_entries.  */
+static struct entry *old_entries;
+static idx_t old_nentries;
+
+/* The entries made during this run.  */
+static struct entry *new_entries;
+static idx_t new_nentries;
+static idx_t new_alloc;
+
+/* Whether the index needs to be written back even if all its old
+   entries were confirmed.  */
+static bool index_modified;
+
+/* When this run started.  */
+static struct timespec start_time;
+
+/* Set *STAMP from the status *ST.  */
+
+static void
+set_stamp (struct stamp *stamp, struct stat const *st)
+{
+  stamp->dev = st->st_dev;
+  stamp->ino = st->st_ino;
+  stamp->size = st->st_size;
+  stamp->mtime = get_stat_mtime (st);
+  stamp->ctime = get_stat_ctime (st);
+}
+
+/* Compare index entries by the identities of their files,
+   returning a value compatible with strcmp.  */
+
+static int
+compare_entries (void const *a, void const *b)
+{
+  struct entry const *e = a;
+  struct entry const *f = b;
+  for (int i = 0; i < 2; i++)
+    {
+      if (e->file[i].dev != f->file[i].dev)
+	return e->file[i].dev < f->file[i].dev ? -1 : 1;
+      if (e->file[i].ino != f->file[i].ino)
+	return e->file[i].ino < f->file[i].ino ? -1 : 1;
+    }
+  return 0;
+}
+
+/* Return true if the stamps S and T say that the same file is
+   unchanged.  */
+
+static bool
+same_stamp (struct stamp const *s, struct stamp const *t)
+{
+  return (s->dev == t->dev && s->ino == t->ino && s->size == t->size
+	  && timespec_cmp (s->mtime, t->mtime) == 0
+	  && timespec_cmp (s->ctime, t->ctime) == 0);
+}
+
+/* Read one stamp from STREAM into *STAMP.  Return true if successful.  */
+
+static bool
+read_stamp (FILE *stream, struct stamp *stamp)
+{
+  intmax_t msec, csec;
+  long int mnsec, cnsec;
+  if (fscanf (stream, "%ju%ju%jd%jd%ld%jd%ld",
+	      &stamp->dev, &stamp->ino, &stamp->size,
+	      &msec, &mnsec, &csec, &cnsec) != 7
+      || ! (0 <= mnsec && mnsec < TIMESPEC_HZ
+	    && 0 <= cnsec && cnsec < TIMESPEC_HZ)
+      || ckd_add (&stamp->mtime.tv_sec, msec, 0)
+      || ckd_add (&stamp->ctime.tv_sec, csec, 0))
+    return false;
+  stamp->mtime.tv_nsec = mnsec;
+  stamp->ctime.tv_nsec = cnsec;
+  return true;
+}
+
+/* Write the stamp *STAMP to STREAM.  */
+
+static void
+write_stamp (FILE *stream, struct stamp const *stamp)
+{
+  fprintf (stream, "%ju %ju %jd %jd %ld %jd %ld",
+	   stamp->dev, stamp->ino, stamp->size,
+	   (intmax_t) stamp->mtime.tv_sec, (long int) stamp->mtime.tv_nsec,
+	   (intmax_t) stamp->ctime.tv_sec, (long int) stamp->ctime.tv_nsec);
+}
+
+/* Read the index from the file NAME, which need not exist.  */
+
+void
+index_load (char const *name)
+{
+  index_name = name;
+  timespec_get (&start_time, TIME_UTC);
+
+  FILE *stream = fopen (name, "r");
+  if (!stream)
+    {
+      if (errno != ENOENT)
+	pfatal_with_name (name);
+      return;
+    }
+
+  idx_t alloc = 0;
+  bool valid = true;
+  for (int c; (c = getc (stream)) != EOF; )
+    {
+      ungetc (c, stream);
+      if (old_nentries == alloc)
+	old_entries = xpalloc (old_entries, &alloc, 1, -1,
+			       sizeof *old_entries);
+      struct entry *e = &old_entries[old_nentries];
+      if (! (read_stamp (stream, &e->file[0])
+	     && read_stamp (stream, &e->file[1])
+	     && getc (stream) == '\n'))
+	{
+	  valid = false;
+	  break;
+	}
+      e->confirmed = false;
+      old_nentries++;
+    }
+
+  if (ferror (stream) || fclose (stream) != 0)
+    pfatal_with_name (name);
+
+  if (!valid)
+    {
+      error (0, 0, _("%s: ignoring invalid tree index"), squote (0, name));
+      old_nentries = 0;
+      index_modified = true;
+    }
+
+  qsort (old_entries, old_nentries, sizeof *old_entries, compare_entries);
+}
+
+/* Return true if the index says that the regular files of CMP are
+   identical and that neither has changed since that was found.  */
+
+bool
+index_lookup (struct comparison const *cmp)
+{
+  struct entry key;
+  for (int f = 0; f < 2; f++)
+    set_stamp (&key.file[f], &cmp->file[f].stat);
+
+  struct entry *e = bsearch (&key, old_entries, old_nentries,
+			     sizeof *old_entries, compare_entries);
+  if (! (e && same_stamp (&e->file[0], &key.file[0])
+	 && same_stamp (&e->file[1], &key.file[1])))
+    return false;
+  e->confirmed = true;
+  return true;
+}
+
+/* Record in the index that the regular files of CMP are identical.  */
+
+void
+index_record (struct comparison const *cmp)
+{
+  /* Do not trust a status change time that is not before this run
+     started, as a file changed during this run might then keep the
+     same status change time if timestamps are coarse.  */
+  for (int f = 0; f < 2; f++)
+    if (! (get_stat_ctime (&cmp->file[f].stat).tv_sec < start_time.tv_sec))
+      return;
+
+  if (new_nentries == new_alloc)
+    new_entries = xpalloc (new_entries, &new_alloc, 1, -1,
+			   sizeof *new_entries);
+  struct entry *e = &new_entries[new_nentries++];
+  for (int f = 0; f < 2; f++)
+    set_stamp (&e->file[f], &cmp->file[f].stat);
+  e->confirmed = true;
+  index_modified = true;
+}
+
+/* Write the index back if it has changed, keeping only the confirmed
+   entries and replacing the old index file atomically.  Return true
+   if successful.  */
+
+bool
+index_save (void)
+{
+  bool modified = index_modified;
+  for (idx_t i = 0; i < old_nentries; i++)
+    modified |= !old_entries[i].confirmed;
+  if (!modified)
+    return true;
+
+  /* Use a unique temporary name, as other runs of diff can be saving
+     the same index at the same time.  */
+  idx_t namelen = strlen (index_name);
+  char *tmpname = ximalloc (namelen + sizeof ".XXXXXX");
+  strcpy (stpcpy (tmpname, index_name), ".XXXXXX");
+  int fd = mkstemp (tmpname);
+  FILE *stream = fd < 0 ? nullptr : fdopen (fd, "w");
+  if (!stream && 0 <= fd)
+    close (fd);
+
+  bool ok = false;
+  if (stream)
+    {
+      for (int i = 0; i < 2; i++)
+	{
+	  struct entry const *entries = i ? new_entries : old_entries;
+	  idx_t nentries = i ? new_nentries : old_nentries;
+	  for (idx_t j = 0; j < nentries; j++)
+	    if (entries[j].confirmed)
+	      {
+		write_stamp (stream, &entries[j].file[0]);
+		putc (' ', stream);
+		write_stamp (stream, &entries[j].file[1]);
+		putc ('\n', stream);
+	      }
+	}
+      ok = (!ferror (stream)) & (fclose (stream) == 0);
+      ok = ok && rename (tmpname, index_name) == 0;
+    }
+
+  if (!ok)
+    {
+      perror_with_name (tmpname);
+      if (0 <= fd)
+	unlink (tmpname);
+    }
+  free (tmpname);
+  return ok;
+}
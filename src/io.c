@@ -21,12 +21,14 @@
 #include "diff.h"
 #include <binary-io.h>
 #include <cmpbuf.h>
+#include <fadvise.h>
 #include <file-type.h>
 #include <ialloc.h>
 #include <mcel.h>
 #include <xalloc.h>
 
 #include <ctype.h>
+#include <sys/random.h>
 #include <uchar.h>
 
 /* The type of a hash value.  */
@@ -41,10 +43,20 @@ rol (hash_value v, int n)
   return v << n | v >> (HASH_VALUE_WIDTH - n);
 }
 
-/* Given a hash value and a new character, return a new hash value.  */
+/* Keys for hashing, chosen at random once per process.  */
+static hash_value hash_key[2];
+
+/* Given a hash value and a new character, return a new hash value.
+   If KEYED, the result depends on the keys in a way that is hard to
+   predict, so that lines cannot be crafted to collide.  */
 static hash_value
-hash (hash_value h, hash_value c)
+hash (bool keyed, hash_value h, hash_value c)
 {
+  if (keyed)
+    {
+      h = (h ^ c) * hash_key[1];
+      return h ^ h >> (HASH_VALUE_WIDTH / 2);
+    }
   return rol (h, 7) + c;
 }
 
@@ -67,6 +79,12 @@ static lin *buckets;
 /* Number of buckets in the hash table array, not counting buckets[-1].  */
 static idx_t nbuckets;
 
+/* Whether lines are hashed with the keyed hash.  The unkeyed hash is
+   faster, but lines can be crafted so that it puts them all in one
+   bucket, so switch to the keyed hash when a chain gets this long.  */
+static bool keyed_hashing;
+enum { LONG_CHAIN = 64 };
+
 /* Array in which the equivalence classes are allocated.
    The bucket-chains go through the elements in this array.
    The number of an equivalence class is its index in this array.  */
@@ -208,6 +226,7 @@ slurp (struct file_data *current)
 	    {
 	      current->buffer = buffer;
 	      current->bufsize = cc;
+	      advise_huge_pages (buffer, cc);
 	    }
 
 	  #if __GNUC__ == 13
@@ -220,8 +239,11 @@ slurp (struct file_data *current)
 
   while (file_block_read (current, current->bufsize - current->buffered),
 	 !current->eof)
-    current->buffer = xpalloc (current->buffer, &current->bufsize,
-			       extra_room, -1, 1);
+    {
+      current->buffer = xpalloc (current->buffer, &current->bufsize,
+				 extra_room, -1, 1);
+      advise_huge_pages (current->buffer, current->bufsize);
+    }
 
   if (current->bufsize - current->buffered < extra_room)
     {
@@ -245,16 +267,24 @@ same_ch_err (char32_t ch1, unsigned char err1, char32_t ch2, unsigned char err2)
    For efficiency, this is invoked only when the lines do not match exactly
    but an option like -i might cause us to ignore the difference.
    Return nonzero if the lines differ.
-   Line lengths do not include the trailing newline.  */
-
-static bool
-lines_differ (char const *s1, idx_t s1len, char const *s2, idx_t s2len)
+   Line lengths do not include the trailing newline.
+   IG_CASE, IG_WHITE_SPACE and UNIBYTE are as in find_and_hash_each_line;
+   they are constants in each instance of this function.  */
+
+ATTRIBUTE_ALWAYS_INLINE static inline bool
+lines_differ_in_mode (char const *s1, idx_t s1len,
+		      char const *s2, idx_t s2len, bool ig_case,
+		      enum DIFF_white_space ig_white_space, bool unibyte)
 {
   char const *t1 = s1;
   char const *t2 = s2;
   intmax_t tab = 0, column = 0;
 
-  if (MB_CUR_MAX == 1)
+  /* Columns matter only when expanding tabs.  */
+  bool columns = (ig_white_space == IGNORE_TAB_EXPANSION
+		  || ig_white_space == IGNORE_TAB_EXPANSION_AND_TRAILING_SPACE);
+
+  if (unibyte)
     while (true)
       {
 	unsigned char c1 = *t1++;
@@ -263,7 +293,7 @@ lines_differ (char const *s1, idx_t s1len, char const *s2, idx_t s2len)
 	/* Test for exact char equality first, since it's a common case.  */
 	if (c1 != c2)
 	  {
-	    switch (ignore_white_space)
+	    switch (ig_white_space)
 	      {
 	      case IGNORE_ALL_SPACE:
 		/* For -w, just skip past any white space.  */
@@ -348,7 +378,7 @@ lines_differ (char const *s1, idx_t s1len, char const *s2, idx_t s2len)
 		    /* Both lines have nothing but whitespace left.  */
 		    return false;
 		  }
-		if (ignore_white_space == IGNORE_TRAILING_SPACE)
+		if (ig_white_space == IGNORE_TRAILING_SPACE)
 		  break;
 		FALLTHROUGH;
 	      case IGNORE_TAB_EXPANSION:
@@ -389,7 +419,7 @@ lines_differ (char const *s1, idx_t s1len, char const *s2, idx_t s2len)
 		break;
 	      }
 
-	    if (ignore_case)
+	    if (ig_case)
 	      {
 		c1 = tolower (c1);
 		c2 = tolower (c2);
@@ -399,38 +429,39 @@ lines_differ (char const *s1, idx_t s1len, char const *s2, idx_t s2len)
 	      break;
 	  }
 
-	switch (c1)
-	  {
-	  case '\n':
-	    return false;
+	if (c1 == '\n')
+	  return false;
 
-	  case '\r':
-	    tab = column = 0;
-	    break;
+	if (columns)
+	  switch (c1)
+	    {
+	    case '\r':
+	      tab = column = 0;
+	      break;
 
-	  case '\b':
-	    if (0 < column)
-	      column--;
-	    else if (0 < tab)
-	      {
-		tab--;
-		column = tabsize - 1;
-	      }
-	    break;
+	    case '\b':
+	      if (0 < column)
+		column--;
+	      else if (0 < tab)
+		{
+		  tab--;
+		  column = tabsize - 1;
+		}
+	      break;
 
-	  case '\0': case '\a': case '\f': case '\v':
-	    break;
+	    case '\0': case '\a': case '\f': case '\v':
+	      break;
 
-	  default:
-	    column += !! isprint (c1);
-	    if (column < tabsize)
+	    default:
+	      column += !! isprint (c1);
+	      if (column < tabsize)
+		break;
+	      FALLTHROUGH;
+	    case '\t':
+	      tab++;
+	      column = 0;
 	      break;
-	    FALLTHROUGH;
-	  case '\t':
-	    tab++;
-	    column = 0;
-	    break;
-	  }
+	    }
       }
   else
     {
@@ -450,7 +481,7 @@ lines_differ (char const *s1, idx_t s1len, char const *s2, idx_t s2len)
 	  /* Test for exact equality first, since it's a common case.  */
 	  if (! same_ch_err (ch1, g1.err, ch2, g2.err))
 	    {
-	      switch (ignore_white_space)
+	      switch (ig_white_space)
 		{
 		case IGNORE_ALL_SPACE:
 		  /* For -w, just skip past any white space.  */
@@ -553,7 +584,7 @@ lines_differ (char const *s1, idx_t s1len, char const *s2, idx_t s2len)
 		      /* Both lines have nothing but whitespace left.  */
 		      return false;
 		    }
-		  if (ignore_white_space == IGNORE_TRAILING_SPACE)
+		  if (ig_white_space == IGNORE_TRAILING_SPACE)
 		    break;
 		  FALLTHROUGH;
 		case IGNORE_TAB_EXPANSION:
@@ -607,7 +638,7 @@ lines_differ (char const *s1, idx_t s1len, char const *s2, idx_t s2len)
 		  break;
 		}
 
-	      if (ignore_case)
+	      if (ig_case)
 		{
 		  ch1 = c32tolower (ch1);
 		  ch2 = c32tolower (ch2);
@@ -617,39 +648,40 @@ lines_differ (char const *s1, idx_t s1len, char const *s2, idx_t s2len)
 		break;
 	    }
 
-	  switch (ch1)
-	    {
-	    case '\n':
-	      return false;
+	  if (ch1 == '\n')
+	    return false;
 
-	    case '\r':
-	      tab = column = 0;
-	      break;
+	  if (columns)
+	    switch (ch1)
+	      {
+	      case '\r':
+		tab = column = 0;
+		break;
 
-	    case '\b':
-	      if (0 < column)
-		column--;
-	      else if (0 < tab)
-		{
-		  tab--;
-		  column = tabsize - 1;
-		}
-	      break;
+	      case '\b':
+		if (0 < column)
+		  column--;
+		else if (0 < tab)
+		  {
+		    tab--;
+		    column = tabsize - 1;
+		  }
+		break;
 
-	    case '\a': case '\f': case '\v':
-	      break;
+	      case '\a': case '\f': case '\v':
+		break;
 
-	    default:
-	      /* Assume that downcasing does not change print width.  */
-	      column += g1.err ? 1 : c32width (ch1);
-	      if (column < tabsize)
+	      default:
+		/* Assume that downcasing does not change print width.  */
+		column += g1.err ? 1 : c32width (ch1);
+		if (column < tabsize)
+		  break;
+		FALLTHROUGH;
+	      case '\t':
+		tab++;
+		column = 0;
 		break;
-	      FALLTHROUGH;
-	    case '\t':
-	      tab++;
-	      column = 0;
-	      break;
-	    }
+	      }
 
 	  ch1prev = ch1;
 	}
@@ -658,130 +690,285 @@ lines_differ (char const *s1, idx_t s1len, char const *s2, idx_t s2len)
   return true;
 }
 
-/* Split the file into lines, simultaneously computing the equivalence
-   class for each line.  If two lines hash differently, lines_differ
-   must return false.  */
+/* Compare the lines S1 and S2, of lengths S1LEN and S2LEN including
+   their trailing newlines, in byte order, ignoring any options that
+   make lines equivalent.  Return a value compatible with strcmp.  */
 
-static void
-find_and_hash_each_line (struct file_data *current)
+int
+compare_line_bytes (char const *s1, idx_t s1len, char const *s2, idx_t s2len)
 {
-  char const *p = current->prefix_end;
+  int r = memcmp (s1, s2, MIN (s1len, s2len) - 1);
+  return r ? r : (s1len > s2len) - (s1len < s2len);
+}
 
-  /* Cache often-used quantities in local variables to help the compiler.  */
-  char const **linbuf = current->linbuf;
-  lin alloc_lines = current->alloc_lines;
-  lin line = 0;
-  lin linbuf_base = current->linbuf_base;
-  lin *cureqs = xinmalloc (alloc_lines, sizeof *cureqs);
-  struct equivclass *eqs = equivs;
-  lin eqs_index = equivs_index;
-  idx_t eqs_alloc = equivs_alloc;
-  char const *suffix_begin = current->suffix_begin;
-  char const *bufend = file_buffer (current) + current->buffered;
-  bool ig_case = ignore_case;
-  enum DIFF_white_space ig_white_space = ignore_white_space;
-  bool unibyte = MB_CUR_MAX == 1;
-  bool diff_length_compare_anyway =
-    (ig_white_space != IGNORE_NO_WHITE_SPACE) | (!unibyte & ig_case);
-  bool same_length_diff_contents_compare_anyway =
-    diff_length_compare_anyway | ig_case;
+/* Return the end of the line that starts at P: the newline that
+   terminates it, or the --split-lines byte that ends it.  */
 
-  while (p < suffix_begin)
+static char *
+line_end (char const *p)
+{
+  if (split_char == '\n')
+    return rawmemchr (p, '\n');
+  for (;; p++)
+    if (*p == '\n' || (*p == split_char && p[1] != '\n'))
+      return (char *) p;
+}
+
+/* Return true if a line starts at P, which is not the start of its
+   buffer, i.e., if the line before P is complete.  */
+
+static bool
+line_start (char const *p)
+{
+  return line_is_complete (p);
+}
+
+/* Mix the word W into the hash value H, using the odd multiplier K.
+   The rotation moves the well-mixed high-order bits of the product to
+   where the next multiplication spreads them.  */
+
+static hash_value
+hash_word (hash_value h, hash_value w, hash_value k)
+{
+  return rol ((h ^ w) * k, HASH_VALUE_WIDTH / 2 - 1);
+}
+
+/* Return the hash of the text of the line at *PP, i.e., its bytes
+   other than any trailing newline, and set *PP to point at the line's
+   end.  Use the keyed hash if KEYED.  This suits the default mode,
+   where lines are equivalent only if their texts are equal.  Hash a
+   word at a time in four independent lanes, so that very long lines
+   like those of minified files hash quickly.  If the unkeyed hash
+   changes, increment LINE_HASH_VERSION.  */
+
+ATTRIBUTE_ALWAYS_INLINE static inline hash_value
+hash_line_bytes (char const **pp, bool keyed)
+{
+  char const *p = *pp;
+  char const *lineend = line_end (p);
+  char const *end = lineend + (*lineend != '\n');
+  idx_t len = end - p;
+  hash_value k = keyed ? hash_key[1] : (hash_value) 0x9e3779b97f4a7c15;
+  hash_value h = keyed ? hash_key[0] : 0;
+  hash_value w;
+
+  if (4 * sizeof w <= len)
     {
-      char const *ip = p;
-      hash_value h = 0;
+      hash_value h1 = h ^ 1, h2 = h ^ 2, h3 = h ^ 3;
+      do
+	{
+	  hash_value w1, w2, w3;
+	  memcpy (&w, p, sizeof w);
+	  memcpy (&w1, p + sizeof w, sizeof w);
+	  memcpy (&w2, p + 2 * sizeof w, sizeof w);
+	  memcpy (&w3, p + 3 * sizeof w, sizeof w);
+	  h = hash_word (h, w, k);
+	  h1 = hash_word (h1, w1, k);
+	  h2 = hash_word (h2, w2, k);
+	  h3 = hash_word (h3, w3, k);
+	  p += 4 * sizeof w;
+	}
+      while (4 * sizeof w <= end - p);
+      h = hash_word (hash_word (hash_word (h, h1, k), h2, k), h3, k);
+    }
 
-      /* Hash this line until we find a newline.  */
-      switch (ig_white_space)
-        {
-        case IGNORE_ALL_SPACE:
-	  if (unibyte)
-	    for (unsigned char c; (c = *p) != '\n'; p++)
-	      {
-		if (! isspace (c))
-		  h = hash (h, ig_case ? tolower (c) : c);
-	      }
-	  else
-	    for (mcel_t g; *p != '\n'; p += g.len)
+  for (; sizeof w <= end - p; p += sizeof w)
+    {
+      memcpy (&w, p, sizeof w);
+      h = hash_word (h, w, k);
+    }
+
+  if (p < end)
+    {
+      for (w = 0; p < end; p++)
+	w = w << CHAR_BIT | (unsigned char) *p;
+      h = hash_word (h, w, k);
+    }
+
+  *pp = lineend;
+  return hash_word (h, len, k);
+}
+
+/* Return the hash of the line at *PP, and set *PP to point at the
+   line's terminating newline.  LIM is the end of the buffer.  IG_CASE,
+   IG_WHITE_SPACE and UNIBYTE are as in find_and_hash_each_line.
+   Use the keyed hash if KEYED.  The arguments other than PP and LIM
+   are constants in each instance of this function.  If the unkeyed
+   hash changes, increment LINE_HASH_VERSION.  */
+
+ATTRIBUTE_ALWAYS_INLINE static inline hash_value
+hash_line_in_mode (char const **pp, char const *lim, bool ig_case,
+		   enum DIFF_white_space ig_white_space, bool unibyte,
+		   bool keyed)
+{
+  if (ig_white_space == IGNORE_NO_WHITE_SPACE && !ig_case)
+    return hash_line_bytes (pp, keyed);
+
+  char const *p = *pp;
+  hash_value h = keyed ? hash_key[0] : 0;
+
+  /* Hash this line until we find a newline.  */
+  switch (ig_white_space)
+    {
+    case IGNORE_ALL_SPACE:
+      if (unibyte)
+	for (unsigned char c; (c = *p) != '\n'; p++)
+	  {
+	    if (! isspace (c))
+	      h = hash (keyed, h, ig_case ? tolower (c) : c);
+	  }
+      else
+	for (mcel_t g; *p != '\n'; p += g.len)
+	  {
+	    g = mcel_scan (p, lim);
+	    if (! c32isspace (g.ch))
+	      h = hash (keyed, h, (ig_case ? c32tolower (g.ch) : g.ch) - g.err);
+	  }
+      break;
+
+    case IGNORE_SPACE_CHANGE:
+      if (unibyte)
+	for (unsigned char c; (c = *p) != '\n'; p++)
+	  {
+	    if (isspace (c))
 	      {
-		g = mcel_scan (p, suffix_begin);
-		if (! c32isspace (g.ch))
-		  h = hash (h, (ig_case ? c32tolower (g.ch) : g.ch) - g.err);
+		do
+		  {
+		    c = *++p;
+		    if (c == '\n')
+		      goto hashing_done;
+		  }
+		while (isspace (c));
+
+		h = hash (keyed, h, ' ');
 	      }
-          break;
 
-        case IGNORE_SPACE_CHANGE:
-	  if (unibyte)
-	    for (unsigned char c; (c = *p) != '\n'; p++)
+	    /* C is now the first non-space.  */
+	    h = hash (keyed, h, ig_case ? tolower (c) : c);
+	  }
+      else
+	for (mcel_t g; *p != '\n'; p += g.len)
+	  {
+	    g = mcel_scan (p, lim);
+	    if (c32isspace (g.ch))
 	      {
-		if (isspace (c))
+		do
 		  {
-		    do
-		      {
-			c = *++p;
-			if (c == '\n')
-			  goto hashing_done;
-		      }
-		    while (isspace (c));
-
-		    h = hash (h, ' ');
+		    p += g.len;
+		    if (*p == '\n')
+		      goto hashing_done;
+		    g = mcel_scan (p, lim);
 		  }
+		while (c32isspace (g.ch));
 
-		/* C is now the first non-space.  */
-		h = hash (h, ig_case ? tolower (c) : c);
+		h = hash (keyed, h, ' ');
 	      }
-	  else
-	    for (mcel_t g; *p != '\n'; p += g.len)
-	      {
-		g = mcel_scan (p, suffix_begin);
-		if (c32isspace (g.ch))
+
+	    /* G is now the first non-space.  */
+	    h = hash (keyed, h, (ig_case ? c32tolower (g.ch) : g.ch) - g.err);
+	  }
+      break;
+
+    case IGNORE_TAB_EXPANSION:
+    case IGNORE_TAB_EXPANSION_AND_TRAILING_SPACE:
+    case IGNORE_TRAILING_SPACE:
+      {
+	intmax_t tab = 0, column = 0;
+	if (unibyte)
+	  for (unsigned char c; (c = *p) != '\n'; p++)
+	    {
+	      intmax_t repetitions = 1;
+
+	      if (ig_white_space & IGNORE_TRAILING_SPACE
+		  && isspace (c))
+		{
+		  char const *p1 = p;
+		  unsigned char c1;
+		  do
+		    {
+		      c1 = *++p1;
+		      if (c1 == '\n')
+			{
+			  p = p1;
+			  goto hashing_done;
+			}
+		    }
+		  while (isspace (c1));
+		}
+
+	      if (ig_white_space & IGNORE_TAB_EXPANSION)
+		switch (c)
 		  {
-		    do
+		  case '\b':
+		    if (0 < column)
+		      column--;
+		    else if (0 < tab)
 		      {
-			p += g.len;
-			if (*p == '\n')
-			  goto hashing_done;
-			g = mcel_scan (p, suffix_begin);
+			tab--;
+			column = tabsize - 1;
 		      }
-		    while (c32isspace (g.ch));
+		    break;
+
+		  case '\t':
+		    c = ' ';
+		    repetitions = tabsize - column % tabsize;
+		    tab += column / tabsize + 1;
+		    column = 0;
+		    break;
+
+		  case '\r':
+		    tab = column = 0;
+		    break;
+
+		  case '\0': case '\a': case '\f': case '\v':
+		    break;
 
-		    h = hash (h, ' ');
+		  default:
+		    column++;
+		    break;
 		  }
 
-		/* G is now the first non-space.  */
-		h = hash (h, (ig_case ? c32tolower (g.ch) : g.ch) - g.err);
-	      }
-          break;
+	      if (ig_case)
+		c = tolower (c);
 
-        case IGNORE_TAB_EXPANSION:
-        case IGNORE_TAB_EXPANSION_AND_TRAILING_SPACE:
-        case IGNORE_TRAILING_SPACE:
-          {
-	    intmax_t tab = 0, column = 0;
-	    if (unibyte)
-	      for (unsigned char c; (c = *p) != '\n'; p++)
-		{
-		  intmax_t repetitions = 1;
+	      do
+		h = hash (keyed, h, c);
+	      while (--repetitions != 0);
+	    }
+	else
+	  for (mcel_t g; *p != '\n'; p += g.len)
+	    {
+	      intmax_t repetitions = 1;
 
+	      g = mcel_scan (p, lim);
+	      char32_t ch;
+	      if (g.err)
+		{
+		  ch = -g.err;
+		  column++;
+		}
+	      else
+		{
+		  ch = g.ch;
 		  if (ig_white_space & IGNORE_TRAILING_SPACE
-		      && isspace (c))
+		      && c32isspace (ch))
 		    {
-		      char const *p1 = p;
-		      unsigned char c1;
-		      do
+		      char const *p1 = p + g.len;
+		      for (mcel_t g1; ; p1 += g1.len)
 			{
-			  c1 = *++p1;
-			  if (c1 == '\n')
+			  if (*p1 == '\n')
 			    {
 			      p = p1;
 			      goto hashing_done;
 			    }
+			  g1 = mcel_scan (p1, lim);
+			  if (! c32isspace (g1.ch))
+			    break;
 			}
-		      while (isspace (c1));
 		    }
 
 		  if (ig_white_space & IGNORE_TAB_EXPANSION)
-		    switch (c)
+		    switch (ch)
 		      {
 		      case '\b':
 			if (0 < column)
@@ -794,7 +981,7 @@ find_and_hash_each_line (struct file_data *current)
 			break;
 
 		      case '\t':
-			c = ' ';
+			ch = ' ';
 			repetitions = tabsize - column % tabsize;
 			tab += column / tabsize + 1;
 			column = 0;
@@ -808,127 +995,290 @@ find_and_hash_each_line (struct file_data *current)
 			break;
 
 		      default:
-			column++;
+			column += c32width (ch);
 			break;
 		      }
 
 		  if (ig_case)
-		    c = tolower (c);
-
-		  do
-		    h = hash (h, c);
-		  while (--repetitions != 0);
+		    ch = c32tolower (ch);
 		}
-	    else
-	      for (mcel_t g; *p != '\n'; p += g.len)
-		{
-		  intmax_t repetitions = 1;
 
-		  g = mcel_scan (p, suffix_begin);
-		  char32_t ch;
-		  if (g.err)
-		    {
-		      ch = -g.err;
-		      column++;
-		    }
-		  else
-		    {
-		      ch = g.ch;
-		      if (ig_white_space & IGNORE_TRAILING_SPACE
-			  && c32isspace (ch))
-			{
-			  char const *p1 = p + g.len;
-			  for (mcel_t g1; ; p1 += g1.len)
-			    {
-			      if (*p1 == '\n')
-				{
-				  p = p1;
-				  goto hashing_done;
-				}
-			      g1 = mcel_scan (p1, suffix_begin);
-			      if (! c32isspace (g1.ch))
-				break;
-			    }
-			}
+	      do
+		h = hash (keyed, h, ch);
+	      while (--repetitions != 0);
+	    }
+      }
+      break;
 
-		      if (ig_white_space & IGNORE_TAB_EXPANSION)
-			switch (ch)
-			  {
-			  case '\b':
-			    if (0 < column)
-			      column--;
-			    else if (0 < tab)
-			      {
-				tab--;
-				column = tabsize - 1;
-			      }
-			    break;
+    default:
+      /* Only case is ignored, as hash_line_bytes handled the rest.  */
+      if (unibyte)
+	for (unsigned char c; (c = *p) != '\n'; p++)
+	  h = hash (keyed, h, tolower (c));
+      else
+	for (mcel_t g; *p != '\n'; p += g.len)
+	  {
+	    g = mcel_scan (p, lim);
+	    h = hash (keyed, h, c32tolower (g.ch) - g.err);
+	  }
+      break;
+    }
 
-			  case '\t':
-			    ch = ' ';
-			    repetitions = tabsize - column % tabsize;
-			    tab += column / tabsize + 1;
-			    column = 0;
-			    break;
+ hashing_done:
+  *pp = p;
+  return h;
+}
 
-			  case '\r':
-			    tab = column = 0;
-			    break;
+/* Kernels that hash and compare lines, specialized for one
+   combination of options so that their inner loops do only the work
+   that the options need.  */
+struct line_kernels
+{
+  hash_value (*hash_line) (char const **, char const *);
+  bool (*lines_differ) (char const *, idx_t, char const *, idx_t);
+};
 
-			  case '\0': case '\a': case '\f': case '\v':
-			    break;
+/* Define the kernels for white space option IGNORE_##WS, for ignoring
+   case if IG_CASE, and for unibyte locales if UNIBYTE.  */
+#define DEFINE_LINE_KERNELS(ws, ig_case, unibyte)			\
+  static hash_value							\
+  hash_line_##ws##_##ig_case##_##unibyte (char const **pp,		\
+					  char const *lim)		\
+  {									\
+    return hash_line_in_mode (pp, lim, ig_case, IGNORE_##ws, unibyte,	\
+			      false);					\
+  }									\
+  static bool								\
+  lines_differ_##ws##_##ig_case##_##unibyte (char const *s1,		\
+					     idx_t s1len,		\
+					     char const *s2,		\
+					     idx_t s2len)		\
+  {									\
+    return lines_differ_in_mode (s1, s1len, s2, s2len,			\
+				 ig_case, IGNORE_##ws, unibyte);	\
+  }
+#define DEFINE_LINE_KERNELS_FOR(ws)	\
+  DEFINE_LINE_KERNELS (ws, 0, 0)	\
+  DEFINE_LINE_KERNELS (ws, 0, 1)	\
+  DEFINE_LINE_KERNELS (ws, 1, 0)	\
+  DEFINE_LINE_KERNELS (ws, 1, 1)
+
+DEFINE_LINE_KERNELS_FOR (NO_WHITE_SPACE)
+DEFINE_LINE_KERNELS_FOR (TAB_EXPANSION)
+DEFINE_LINE_KERNELS_FOR (TRAILING_SPACE)
+DEFINE_LINE_KERNELS_FOR (TAB_EXPANSION_AND_TRAILING_SPACE)
+DEFINE_LINE_KERNELS_FOR (SPACE_CHANGE)
+DEFINE_LINE_KERNELS_FOR (ALL_SPACE)
+
+/* The kernels, indexed by white space option, whether to ignore case,
+   and whether the locale is unibyte.  */
+#define LINE_KERNELS(ws, ig_case, unibyte)				\
+  { hash_line_##ws##_##ig_case##_##unibyte,				\
+    lines_differ_##ws##_##ig_case##_##unibyte }
+#define LINE_KERNELS_FOR(ws)						\
+  [IGNORE_##ws] = {{ LINE_KERNELS (ws, 0, 0),				\
+		     LINE_KERNELS (ws, 0, 1) },				\
+		   { LINE_KERNELS (ws, 1, 0),				\
+		     LINE_KERNELS (ws, 1, 1) }}
+static struct line_kernels const line_kernels[][2][2] =
+  {
+    LINE_KERNELS_FOR (NO_WHITE_SPACE),
+    LINE_KERNELS_FOR (TAB_EXPANSION),
+    LINE_KERNELS_FOR (TRAILING_SPACE),
+    LINE_KERNELS_FOR (TAB_EXPANSION_AND_TRAILING_SPACE),
+    LINE_KERNELS_FOR (SPACE_CHANGE),
+    LINE_KERNELS_FOR (ALL_SPACE),
+  };
+
+/* The kernels for the current options, set by choose_line_kernels.  */
+static struct line_kernels kernels;
+
+/* Choose the kernels for the current options and locale.  */
 
-			  default:
-			    column += c32width (ch);
-			    break;
-			  }
+static void
+choose_line_kernels (void)
+{
+  kernels = line_kernels[ignore_white_space][ignore_case][MB_CUR_MAX == 1];
+}
 
-		      if (ig_case)
-			ch = c32tolower (ch);
-		    }
+/* Return the keyed hash of the line at *PP, and set *PP to point at
+   the line's terminating newline.  LIM is the end of the buffer.
+   The keyed hash is rarely needed, so it has no specialized kernels.  */
 
-		  do
-		    h = hash (h, ch);
-		  while (--repetitions != 0);
-		}
-          }
-          break;
+static hash_value
+hash_line_keyed (char const **pp, char const *lim)
+{
+  return hash_line_in_mode (pp, lim, ignore_case, ignore_white_space,
+			    MB_CUR_MAX == 1, true);
+}
 
-        default:
-	  if (unibyte)
-	    {
-	      if (ig_case)
-		for (unsigned char c; (c = *p) != '\n'; p++)
-		  h = hash (h, tolower (c));
-	      else
-		for (unsigned char c; (c = *p) != '\n'; p++)
-		  h = hash (h, c);
-	    }
-	  else
-	    {
-	      if (ig_case)
-		for (mcel_t g; *p != '\n'; p += g.len)
-		  {
-		    g = mcel_scan (p, suffix_begin);
-		    h = hash (h, c32tolower (g.ch) - g.err);
-		  }
-	      else
-		for (mcel_t g; *p != '\n'; p += g.len)
-		  {
-		    g = mcel_scan (p, suffix_begin);
-		    h = hash (h, g.ch - g.err);
-		  }
-	    }
-          break;
-        }
+/* Return the bucket for lines with hash H.  Mix H with the keys
+   first, so that lines that do not collide in their hashes cannot be
+   crafted to collide in their buckets.  */
+
+static lin *
+hash_bucket (hash_value h)
+{
+  h = (h ^ hash_key[0]) * hash_key[1];
+  return &buckets[(h ^ h >> (HASH_VALUE_WIDTH / 2)) % nbuckets];
+}
+
+/* Switch to the keyed hash, rehashing the EQS_INDEX - 1 equivalence
+   classes of EQS.  The classes of incomplete lines stay in
+   buckets[-1].  */
+
+static void
+start_keyed_hashing (struct equivclass *eqs, lin eqs_index)
+{
+  keyed_hashing = true;
+  memset (buckets, 0, nbuckets * sizeof *buckets);
+
+  for (lin i = 1; i < eqs_index; i++)
+    {
+      char const *p = eqs[i].line;
+      eqs[i].hash = hash_line_keyed (&p, p + eqs[i].length);
+
+      bool incomplete = false;
+      for (lin j = buckets[-1]; j && !incomplete; j = eqs[j].next)
+	incomplete = i == j;
+      if (!incomplete)
+	{
+	  lin *bucket = hash_bucket (eqs[i].hash);
+	  eqs[i].next = *bucket;
+	  *bucket = i;
+	}
+    }
+}
+
+/* Choose the keys for hashing, if not already chosen.  */
+
+static void
+init_hash_key (void)
+{
+  static bool initialized;
+  if (initialized)
+    return;
+  initialized = true;
+
+  if (getrandom (hash_key, sizeof hash_key, GRND_NONBLOCK)
+      != sizeof hash_key)
+    {
+      /* Fall back on keys that are at least not the same every time.  */
+      struct timespec now;
+      timespec_get (&now, TIME_UTC);
+      hash_key[0] = now.tv_sec ^ (hash_value) now.tv_nsec << 20 ^ getpid ();
+      hash_key[1] = (hash_value) (uintptr_t) &now ^ now.tv_nsec;
+    }
+  hash_key[1] |= 1;
+}
+
+/* Append to the line table TABLE, which has *ALLOC lines allocated,
+   a line at offset OFF with hash H.  Leave room for the final offset.  */
+
+static void
+add_table_line (struct line_table *table, idx_t *alloc, idx_t off,
+		hash_value h)
+{
+  if (table->nlines + 1 >= *alloc)
+    {
+      table->offsets = xpalloc (table->offsets, alloc, 2, -1,
+				sizeof *table->offsets);
+      table->hashes = xirealloc (table->hashes,
+				 *alloc * sizeof *table->hashes);
+    }
+  table->offsets[table->nlines] = off;
+  table->hashes[table->nlines++] = h;
+}
+
+/* Split the file into lines, simultaneously computing the equivalence
+   class for each line.  If two lines hash differently, lines_differ
+   must return false.  */
+
+static void
+find_and_hash_each_line (struct file_data *current)
+{
+  char const *p = current->prefix_end;
+
+  /* Cache often-used quantities in local variables to help the compiler.  */
+  char const **linbuf = current->linbuf;
+  lin alloc_lines = current->alloc_lines;
+  lin line = 0;
+  lin linbuf_base = current->linbuf_base;
+  lin *cureqs = xinmalloc (alloc_lines, sizeof *cureqs);
+  advise_huge_pages (cureqs, alloc_lines * sizeof *cureqs);
+  struct equivclass *eqs = equivs;
+  lin eqs_index = equivs_index;
+  idx_t eqs_alloc = equivs_alloc;
+  char const *suffix_begin = current->suffix_begin;
+  char const *bufend = file_buffer (current) + current->buffered;
+  bool ig_case = ignore_case;
+  enum DIFF_white_space ig_white_space = ignore_white_space;
+  bool unibyte = MB_CUR_MAX == 1;
+  bool diff_length_compare_anyway =
+    (ig_white_space != IGNORE_NO_WHITE_SPACE) | (!unibyte & ig_case);
+  bool same_length_diff_contents_compare_anyway =
+    diff_length_compare_anyway | ig_case;
+  hash_value (*hash_line) (char const **, char const *)
+    = keyed_hashing ? hash_line_keyed : kernels.hash_line;
+
+  /* With a line cache, use the cached line table of the whole file if
+     there is one, and otherwise build one.  K is the index in the
+     table of the line at P.  The table has unkeyed hashes, so it is
+     of no use once lines are hashed with the keyed hash.  Its lines
+     are ended only by newlines, so it is not used with --split-lines.  */
+  char const *buf = file_buffer (current);
+  struct line_table table = { .nlines = 0 };
+  idx_t table_alloc = 0;
+  lin k = current->prefix_lines;
+  bool caching = (line_cache_dir && !keyed_hashing && split_char == '\n'
+		  && p < suffix_begin
+		  && 0 <= current->desc && S_ISREG (current->stat.st_mode));
+  bool cached = caching && line_cache_load (current, &table);
+  if (cached && ! (k < table.nlines && table.offsets[k] == p - buf))
+    {
+      free (table.data);
+      cached = false;
+    }
+  bool building = caching & !cached;
+  if (building)
+    for (char const *q = buf; q < p; q++)
+      {
+	idx_t off = q - buf;
+	add_table_line (&table, &table_alloc, off,
+			kernels.hash_line (&q, bufend));
+      }
 
-   hashing_done:;
+  while (p < suffix_begin)
+    {
+      char const *ip = p;
+      hash_value h;
+      if (cached)
+	{
+	  h = table.hashes[k];
+	  p = buf + table.offsets[++k] - 1;
+	}
+      else
+	{
+	  h = hash_line (&p, suffix_begin);
+	  if (building)
+	    add_table_line (&table, &table_alloc, ip - buf, h);
+	}
 
-      lin *bucket = &buckets[h % nbuckets];
+      lin *bucket = hash_bucket (h);
 
-      /* Advance past the line's trailing newline.  */
+      /* Advance past the line's trailing newline.  Compare lines by
+	 their texts, which omit any trailing newline, so that a piece
+	 of a line split by --split-lines is equivalent to a line that
+	 consists of the same bytes and a newline.  Both are output
+	 alike.  */
       p++;
       idx_t length = p - ip;
+      idx_t textlen = length - (p[-1] == '\n');
+
+      if (sorted_input && 0 < line
+	  && 0 < compare_line_bytes (linbuf[line - 1], ip - linbuf[line - 1],
+				     ip, length))
+	current->unsorted = true;
 
       if (p == bufend
           && current->missing_newline
@@ -944,13 +1294,17 @@ find_and_hash_each_line (struct file_data *current)
         }
 
       lin i;
-      for (i = *bucket;  ;  i = eqs[i].next)
+      idx_t chain = 0;
+      for (i = *bucket;  ;  i = eqs[i].next, chain++)
         if (!i)
           {
             /* Create a new equivalence class in this bucket.  */
             i = eqs_index++;
             if (i == eqs_alloc)
-	      eqs = xpalloc (eqs, &eqs_alloc, 1, -1, sizeof *eqs);
+	      {
+		eqs = xpalloc (eqs, &eqs_alloc, 1, -1, sizeof *eqs);
+		advise_huge_pages (eqs, eqs_alloc * sizeof *eqs);
+	      }
             eqs[i].next = *bucket;
             eqs[i].hash = h;
             eqs[i].line = ip;
@@ -962,15 +1316,16 @@ find_and_hash_each_line (struct file_data *current)
           {
             char const *eqline = eqs[i].line;
 	    idx_t eqlinelen = eqs[i].length;
+	    idx_t eqtextlen = eqlinelen - (eqline[eqlinelen - 1] == '\n');
 
             /* Reuse existing class if lines_differ reports the lines
                equal.  */
-	    if (eqlinelen == length)
+	    if (eqtextlen == textlen)
               {
                 /* Reuse existing equivalence class if the lines are identical.
                    This detects the common case of exact identity
                    faster than lines_differ would.  */
-		if (memcmp (eqline, ip, length - 1) == 0)
+		if (memcmp (eqline, ip, textlen) == 0)
                   break;
                 if (!same_length_diff_contents_compare_anyway)
                   continue;
@@ -978,7 +1333,7 @@ find_and_hash_each_line (struct file_data *current)
             else if (!diff_length_compare_anyway)
               continue;
 
-	    if (! lines_differ (eqline, eqlinelen, ip, length))
+	    if (! kernels.lines_differ (eqline, eqlinelen, ip, length))
               break;
           }
 
@@ -989,17 +1344,53 @@ find_and_hash_each_line (struct file_data *current)
 	  idx_t n = alloc_lines - linbuf_base;
           linbuf += linbuf_base;
 	  linbuf = xpalloc (linbuf, &n, 1, -1, sizeof *linbuf);
+	  advise_huge_pages (linbuf, n * sizeof *linbuf);
           linbuf -= linbuf_base;
 	  alloc_lines = linbuf_base + n;
           cureqs = xirealloc (cureqs, alloc_lines * sizeof *cureqs);
+	  advise_huge_pages (cureqs, alloc_lines * sizeof *cureqs);
         }
       linbuf[line] = ip;
       cureqs[line] = i;
       ++line;
+
+      if (LONG_CHAIN <= chain && !keyed_hashing)
+	{
+	  start_keyed_hashing (eqs, eqs_index);
+	  hash_line = hash_line_keyed;
+
+	  if (building)
+	    {
+	      free (table.offsets);
+	      free (table.hashes);
+	      building = false;
+	    }
+	  else if (cached)
+	    {
+	      free (table.data);
+	      cached = false;
+	    }
+	}
     }
 
   current->buffered_lines = line;
 
+  if (building)
+    {
+      for (char const *q = suffix_begin; q < bufend; q++)
+	{
+	  idx_t off = q - buf;
+	  add_table_line (&table, &table_alloc, off,
+			  kernels.hash_line (&q, bufend));
+	}
+      table.offsets[table.nlines] = bufend - buf;
+      line_cache_save (current, &table);
+      free (table.offsets);
+      free (table.hashes);
+    }
+  else if (cached)
+    free (table.data);
+
   for (lin i = 0;  ;  i++)
     {
       /* Record the line start for lines in the suffix that we care about.
@@ -1011,6 +1402,7 @@ find_and_hash_each_line (struct file_data *current)
 	  idx_t n = alloc_lines - linbuf_base;
 	  linbuf += linbuf_base;
 	  linbuf = xpalloc (linbuf, &n, 1, -1, sizeof *linbuf);
+	  advise_huge_pages (linbuf, n * sizeof *linbuf);
 	  linbuf -= linbuf_base;
 	  alloc_lines = n - linbuf_base;
         }
@@ -1029,9 +1421,7 @@ find_and_hash_each_line (struct file_data *current)
         break;
 
       line++;
-
-      while (*p++ != '\n')
-        continue;
+      p = line_end (p) + 1;
     }
 
   /* Done with cache in local variables.  */
@@ -1166,7 +1556,7 @@ find_identical_ends (struct file_data filevec[])
   /* Skip back to last line-beginning in the prefix,
      and then discard up to HORIZON_LINES lines from the prefix.  */
   lin hor = horizon_lines;
-  while (p0 != buffer0 && (p0[-1] != '\n' || hor--))
+  while (p0 != buffer0 && (! (line_start (p0) && line_start (p1)) || hor--))
     p0--, p1--;
 
   /* Record the prefix.  */
@@ -1203,12 +1593,11 @@ find_identical_ends (struct file_data filevec[])
          this line to the main body.  Discard up to HORIZON_LINES lines from
          the identical suffix.  Also, discard one extra line,
          because shift_boundaries may need it.  */
-      lin i = horizon_lines + !((buffer0 == p0 || p0[-1] == '\n')
+      lin i = horizon_lines + !((buffer0 == p0 || line_start (p0))
 				&&
-				(buffer1 == p1 || p1[-1] == '\n'));
+				(buffer1 == p1 || line_start (p1)));
       while (i-- && p0 != end0)
-        while (*p0++ != '\n')
-          continue;
+	p0 = line_end (p0) + 1;
 
       p1 += p0 - beg0;
     }
@@ -1250,6 +1639,7 @@ find_identical_ends (struct file_data filevec[])
   lin prefix_mask = prefix_count - 1;
   lin lines = 0;
   char const **linbuf0 = xinmalloc (alloc_lines0, sizeof *linbuf0);
+  advise_huge_pages (linbuf0, alloc_lines0 * sizeof *linbuf0);
   bool prefix_needed = ! (no_diff_means_no_output
 			  && filevec[0].prefix_end == p0
 			  && filevec[1].prefix_end == p1);
@@ -1265,8 +1655,7 @@ find_identical_ends (struct file_data filevec[])
           if (l == alloc_lines0)
 	    linbuf0 = xpalloc (linbuf0, &alloc_lines0, 1, -1, sizeof *linbuf0);
           linbuf0[l] = p0;
-          while (*p0++ != '\n')
-            continue;
+	  p0 = line_end (p0) + 1;
         }
     }
   lin buffered_prefix = prefix_count && context < lines ? context : lines;
@@ -1280,6 +1669,7 @@ find_identical_ends (struct file_data filevec[])
                middle_guess + MIN (context, suffix_guess)))
     xalloc_die ();
   char const **linbuf1 = xnmalloc (alloc_lines1, sizeof *linbuf1);
+  advise_huge_pages (linbuf1, alloc_lines1 * sizeof *linbuf1);
 
   if (buffered_prefix != lines)
     {
@@ -1320,13 +1710,27 @@ static unsigned char const prime_offset[] =
 
 static_assert (PTRDIFF_WIDTH - 1 <= sizeof prime_offset);
 
-/* Given a vector of two file_data objects, read the file associated
-   with each one, and build the table of equivalence classes.
-   Return nonzero if either file appears to be a binary file.
-   If PRETEND_BINARY is nonzero, pretend they are binary regardless.  */
+/* Ask the system to start reading the regular file CURRENT in the
+   background, so that reading it overlaps with other work.  Read
+   ahead at most READ_AHEAD_MAX bytes, so that a huge file does not
+   push the other file out of memory while that file is being read.  */
 
-bool
-read_files (struct file_data filevec[], bool pretend_binary)
+enum { READ_AHEAD_MAX = 8 * 1024 * 1024 };
+
+static void
+read_ahead (struct file_data const *current)
+{
+  if (0 <= current->desc && S_ISREG (current->stat.st_mode)
+      && 0 < current->stat.st_size)
+    fdadvise (current->desc, 0, MIN (current->stat.st_size, READ_AHEAD_MAX),
+	      FADVISE_WILLNEED);
+}
+
+/* Get ready to read the files of FILEVEC.  Return true if either
+   file appears to be a binary file, or if PRETEND_BINARY.  */
+
+static bool
+sip_files (struct file_data filevec[], bool pretend_binary)
 {
   bool skip_test = text | pretend_binary;
   bool appears_binary = pretend_binary | sip (&filevec[0], skip_test);
@@ -1343,13 +1747,35 @@ read_files (struct file_data filevec[], bool pretend_binary)
     {
       set_binary_mode (filevec[0].desc, O_BINARY);
       set_binary_mode (filevec[1].desc, O_BINARY);
-      return true;
     }
+  return appears_binary;
+}
+
+/* Given a vector of two file_data objects, read the file associated
+   with each one, and build the table of equivalence classes.
+   Return nonzero if either file appears to be a binary file.
+   If PRETEND_BINARY is nonzero, pretend they are binary regardless.  */
+
+bool
+read_files (struct file_data filevec[], bool pretend_binary)
+{
+  if (sip_files (filevec, pretend_binary))
+    return true;
+
+  /* Have the system read the second file while this process reads
+     and prepares the first.  */
+  if (filevec[0].desc != filevec[1].desc)
+    read_ahead (&filevec[1]);
 
+  choose_line_kernels ();
   find_identical_ends (filevec);
 
+  init_hash_key ();
+  keyed_hashing = false;
+
   equivs_alloc = filevec[0].alloc_lines + filevec[1].alloc_lines + 1;
   equivs = xnmalloc (equivs_alloc, sizeof *equivs);
+  advise_huge_pages (equivs, equivs_alloc * sizeof *equivs);
   /* Equivalence class 0 is permanently safe for lines that were not
      hashed.  Real equivalence classes start at 1.  */
   equivs_index = 1;
@@ -1360,6 +1786,7 @@ read_files (struct file_data filevec[], bool pretend_binary)
   int p = equivs_alloc <= 256 * 3 ? 9 : floor_log2 (equivs_alloc / 3) + 1;
   nbuckets = ((idx_t) 1 << p) - prime_offset[p];
   buckets = xicalloc (nbuckets + 1, sizeof *buckets);
+  advise_huge_pages (buckets, (nbuckets + 1) * sizeof *buckets);
   buckets++;
 
   for (int i = 0; i < 2; i++)
@@ -1372,3 +1799,132 @@ read_files (struct file_data filevec[], bool pretend_binary)
 
   return false;
 }
+
+/* Return the next line of the file CURRENT, whose unread lines start
+   at offset *POS of its buffer, and advance *POS past it.  Read more
+   of the file as needed, keeping only the lines not yet returned in
+   the buffer.  Store the line's length, including its trailing
+   newline, into *LEN.  Return a null pointer at end of file.  As
+   prepare_text does, strip any trailing carriage return if
+   requested, and append a newline to an incomplete last line.  */
+
+static char *
+next_stream_line (struct file_data *current, idx_t *pos, idx_t *len)
+{
+  for (idx_t scanned = *pos; ; )
+    {
+      char *buf = file_buffer (current);
+      char *nl = memchr (buf + scanned, '\n', current->buffered - scanned);
+      if (nl)
+	{
+	  char *line = buf + *pos;
+	  *pos = nl + 1 - buf;
+	  *len = nl + 1 - line;
+	  if (strip_trailing_cr && 2 <= *len && nl[-1] == '\r'
+	      && ! (current->missing_newline && *pos == current->buffered))
+	    {
+	      nl[-1] = '\n';
+	      --*len;
+	    }
+	  return line;
+	}
+      scanned = current->buffered;
+
+      if (current->desc < 0 || current->eof)
+	{
+	  if (*pos == current->buffered)
+	    return nullptr;
+	  buf[current->buffered++] = '\n';
+	  current->missing_newline = true;
+	  continue;
+	}
+
+      /* Keep only the incomplete line, and leave room for a newline
+	 to be appended to it.  */
+      memmove (buf, buf + *pos, current->buffered - *pos);
+      current->buffered -= *pos;
+      scanned -= *pos;
+      *pos = 0;
+      if (current->bufsize - current->buffered <= 1)
+	current->buffer = xpalloc (current->buffer, &current->bufsize, 1, -1, 1);
+      file_block_read (current, current->bufsize - current->buffered - 1);
+    }
+}
+
+/* Like read_files, but instead of building the table of equivalence
+   classes, compare the files of FILEVEC a line at a time as they are
+   read, stopping at the first line that differs.  This suffices when
+   only whether the files differ matters, and no options like
+   --ignore-blank-lines can make the alignment of lines matter.  Lines
+   are equivalent if and only if find_and_hash_each_line would put
+   them into the same equivalence class.  Return true if either file
+   appears to be a binary file.  Otherwise, set *CHANGES to 1 if the
+   files differ and to 0 if not.  */
+
+bool
+stream_files (struct file_data filevec[], int *changes)
+{
+  if (sip_files (filevec, false))
+    return true;
+
+  choose_line_kernels ();
+  *changes = 0;
+  if (filevec[0].desc == filevec[1].desc)
+    return false;
+
+  bool ig_case = ignore_case;
+  enum DIFF_white_space ig_white_space = ignore_white_space;
+  bool unibyte = MB_CUR_MAX == 1;
+  bool diff_length_compare_anyway =
+    (ig_white_space != IGNORE_NO_WHITE_SPACE) | (!unibyte & ig_case);
+  bool same_length_diff_contents_compare_anyway =
+    diff_length_compare_anyway | ig_case;
+
+  idx_t pos[2] = {0, 0};
+  while (true)
+    {
+      char *line[2];
+      idx_t len[2];
+      bool incomplete[2];
+      for (int f = 0; f < 2; f++)
+	{
+	  line[f] = next_stream_line (&filevec[f], &pos[f], &len[f]);
+	  incomplete[f] = (filevec[f].missing_newline
+			   && pos[f] == filevec[f].buffered);
+	}
+      if (! (line[0] && line[1]))
+	{
+	  *changes = !!line[0] | !!line[1];
+	  return false;
+	}
+
+      /* An incomplete last line can equal only the other file's
+	 incomplete last line.  */
+      if (incomplete[0] != incomplete[1]
+	  && ig_white_space < IGNORE_TRAILING_SPACE)
+	break;
+
+      if (len[0] == len[1])
+	{
+	  if (memcmp (line[0], line[1], len[0] - 1) == 0)
+	    continue;
+	  if (!same_length_diff_contents_compare_anyway)
+	    break;
+	}
+      else if (!diff_length_compare_anyway)
+	break;
+
+      hash_value h[2];
+      for (int f = 0; f < 2; f++)
+	{
+	  char const *p = line[f];
+	  h[f] = kernels.hash_line (&p, line[f] + len[f]);
+	}
+      if (h[0] != h[1]
+	  || kernels.lines_differ (line[0], len[0], line[1], len[1]))
+	break;
+    }
+
+  *changes = 1;
+  return false;
+}
@@ -0,0 +1,341 @@
+/* Compare files as sets of keyed records, for GNU DIFF.
+
+   Copyright (C) 2024 Free Software Foundation, Inc.
+
+   This file is part of GNU DIFF.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* With --key-fields=LIST, each line is a record whose key consists of
+   the fields selected by LIST, where fields are separated by the
+   --key-delimiter character (default TAB) and LIST is like the field
+   list of 'cut -f'.  Records of the two files are matched by key with
+   a hash join rather than by the usual algorithm, so reordering
+   records does not count as a difference.  A record that is only in
+   the first file is output as deleted, one only in the second file as
+   added, and one whose lines differ as changed.  */
+
+#include "diff.h"
+
+#include <c-ctype.h>
+#include <xalloc.h>
+
+/* A range of field numbers, origin 1, in a key field list.  */
+struct field_range
+{
+  intmax_t lo, hi;
+};
+
+/* The key fields.  */
+static struct field_range *key_ranges;
+static idx_t nkey_ranges;
+
+/* The character that separates fields.  */
+static char key_delimiter = '\t';
+
+/* A growable buffer of keys.  */
+struct keybuf
+{
+  char *data;
+  idx_t len;
+  idx_t alloc;
+};
+
+/* Parse the decimal number at *P into *N, advancing *P.
+   Return true if there was a positive number there.  */
+
+static bool
+parse_field_number (char const **p, intmax_t *n)
+{
+  char const *s = *p;
+  intmax_t v = 0;
+  for (; c_isdigit (*s); s++)
+    if (ckd_mul (&v, v, 10) || ckd_add (&v, v, *s - '0'))
+      v = INTMAX_MAX;
+  if (s == *p || v == 0)
+    return false;
+  *p = s;
+  *n = v;
+  return true;
+}
+
+/* Use the fields in LIST as record keys.  LIST is a comma-separated
+   list of field numbers and ranges like "N", "N-M", "N-" and "-M".
+   Return true if LIST is valid.  */
+
+bool
+specify_key_fields (char const *list)
+{
+  nkey_ranges = 0;
+  idx_t alloc = 0;
+  for (char const *p = list; ; p++)
+    {
+      struct field_range r = { .lo = 1, .hi = INTMAX_MAX };
+      bool have_lo = parse_field_number (&p, &r.lo);
+      if (*p == '-')
+	{
+	  p++;
+	  bool have_hi = parse_field_number (&p, &r.hi);
+	  if (! ((have_lo | have_hi) && r.lo <= r.hi))
+	    return false;
+	}
+      else if (have_lo)
+	r.hi = r.lo;
+      else
+	return false;
+
+      if (nkey_ranges == alloc)
+	key_ranges = xpalloc (key_ranges, &alloc, 1, -1, sizeof *key_ranges);
+      key_ranges[nkey_ranges++] = r;
+
+      if (!*p)
+	return true;
+      if (*p != ',')
+	return false;
+    }
+}
+
+/* Use the single byte in ARG to separate fields.
+   Return true if ARG is valid.  */
+
+bool
+specify_key_delimiter (char const *arg)
+{
+  if (! (arg[0] && !arg[1]))
+    return false;
+  key_delimiter = arg[0];
+  return true;
+}
+
+/* Return true if FIELD is a key field.  */
+
+static bool
+key_field (intmax_t field)
+{
+  for (idx_t i = 0; i < nkey_ranges; i++)
+    if (key_ranges[i].lo <= field && field <= key_ranges[i].hi)
+      return true;
+  return false;
+}
+
+/* Append to KEYS the key of line I of FILE.  Terminate each field with
+   the delimiter, so that keys compare equal only if all their fields
+   do.  */
+
+static void
+append_key (struct keybuf *keys, struct file_data const *file, lin i)
+{
+  char const *line = file->linbuf[i];
+  char const *lim = file->linbuf[i + 1];
+  if (line < lim && lim[-1] == '\n')
+    lim--;
+
+  for (intmax_t field = 1; ; field++)
+    {
+      char const *end = memchr (line, key_delimiter, lim - line);
+      if (!end)
+	end = lim;
+      if (key_field (field))
+	{
+	  idx_t fieldlen = end - line;
+	  if (keys->alloc - keys->len <= fieldlen)
+	    keys->data = xpalloc (keys->data, &keys->alloc,
+				  fieldlen + 1 - (keys->alloc - keys->len),
+				  -1, 1);
+	  memcpy (keys->data + keys->len, line, fieldlen);
+	  keys->len += fieldlen;
+	  keys->data[keys->len++] = key_delimiter;
+	}
+      if (end == lim)
+	break;
+      line = end + 1;
+    }
+}
+
+/* Return the hash of the key of length LEN at KEY.  */
+
+static size_t
+hash_key (char const *key, idx_t len)
+{
+  size_t h = 0;
+  for (idx_t i = 0; i < len; i++)
+    h = (h << 7 | h >> (SIZE_WIDTH - 7)) + (unsigned char) key[i];
+  return h;
+}
+
+/* Print line I of FILE flagged with LINE_FLAG, in color context CTX.  */
+
+static void
+print_record (char const *line_flag, enum color_context ctx,
+	      struct file_data *file, lin i)
+{
+  set_color_context (ctx);
+  print_1_line_nl (line_flag, &file->linbuf[i], true);
+  set_color_context (RESET_CONTEXT);
+  if (line_is_complete (file->linbuf[i + 1]))
+    putc ('\n', outfile);
+}
+
+/* Print the header of a hunk for record I0 of the first file and
+   record I1 of the second.  Either record can be absent, in which case
+   I0 or I1 is -1 and the header uses the line number AFTER0 or AFTER1
+   of the record after which the other record would go, or -1 if it
+   would go first, as in normal format.  */
+
+static void
+print_record_header (lin i0, lin i1, lin after0, lin after1)
+{
+  begin_output ();
+  set_color_context (LINE_NUMBER_CONTEXT);
+  if (0 <= i0)
+    print_number_range (',', &curr.file[0], i0, i0);
+  else
+    print_number_range (',', &curr.file[0], after0 + 1, after0);
+  putc (change_letter[(0 <= i0 ? OLD : 0) | (0 <= i1 ? NEW : 0)], outfile);
+  if (0 <= i1)
+    print_number_range (',', &curr.file[1], i1, i1);
+  else
+    print_number_range (',', &curr.file[1], after1 + 1, after1);
+  set_color_context (RESET_CONTEXT);
+  putc ('\n', outfile);
+}
+
+/* Compare the files of CMP, which have been read, as sets of keyed
+   records.  Output the differences unless BRIEF.  Return 1 if there
+   are differences, 0 otherwise.  */
+
+int
+diff_keyed_records (struct comparison *cmp)
+{
+  struct file_data *filevec = cmp->file;
+  lin n0 = filevec[0].buffered_lines, n1 = filevec[1].buffered_lines;
+  lin const *e0 = filevec[0].equivs, *e1 = filevec[1].equivs;
+
+  /* Hash the keys of the first file.  Each chain lists records in
+     file order, so that records with duplicate keys match in order.  */
+  struct keybuf keys = {0};
+  idx_t *keyoff = xinmalloc (n0 + 1, sizeof *keyoff);
+  for (lin i = 0; i < n0; i++)
+    {
+      keyoff[i] = keys.len;
+      append_key (&keys, &filevec[0], i);
+    }
+  keyoff[n0] = keys.len;
+
+  idx_t nbuckets = 2 * n0 + 1;
+  lin *buckets = xinmalloc (nbuckets, sizeof *buckets);
+  for (idx_t b = 0; b < nbuckets; b++)
+    buckets[b] = -1;
+  lin *next = xinmalloc (n0 + 1, sizeof *next);
+  for (lin i = n0; 0 < i--; )
+    {
+      lin *bucket = &buckets[hash_key (keys.data + keyoff[i],
+				       keyoff[i + 1] - keyoff[i])
+			     % nbuckets];
+      next[i] = *bucket;
+      *bucket = i;
+    }
+
+  /* Match each record of the second file to an unmatched record of
+     the first file with the same key, preferring one that is
+     unchanged.  */
+  lin *match0 = xinmalloc (n0 + 1, sizeof *match0);
+  lin *match1 = xinmalloc (n1 + 1, sizeof *match1);
+  for (lin i = 0; i < n0; i++)
+    match0[i] = -1;
+  struct keybuf key = {0};
+  int changes = 0;
+  for (lin j = 0; j < n1; j++)
+    {
+      key.len = 0;
+      append_key (&key, &filevec[1], j);
+      lin found = -1;
+      for (lin i = buckets[hash_key (key.data, key.len) % nbuckets];
+	   0 <= i; i = next[i])
+	if (match0[i] < 0 && keyoff[i + 1] - keyoff[i] == key.len
+	    && ! (key.len && memcmp (keys.data + keyoff[i], key.data, key.len)))
+	  {
+	    if (found < 0)
+	      found = i;
+	    if (e0[i] == e1[j])
+	      {
+		found = i;
+		break;
+	      }
+	  }
+      match1[j] = found;
+      if (0 <= found)
+	match0[found] = j;
+      if (! (0 <= found && e0[found] == e1[j]))
+	changes = 1;
+    }
+  for (lin i = 0; i < n0 && !changes; i++)
+    changes = match0[i] < 0;
+
+  if (changes && !brief)
+    {
+      setup_output (file_label[0] ? file_label[0] : filevec[0].name,
+		    file_label[1] ? file_label[1] : filevec[1].name,
+		    cmp->parent != &noparent);
+      curr = *cmp;
+
+      /* Output deleted and changed records in the order of the first
+	 file, then added records in the order of the second.  Place
+	 a deleted or added record after the match of the nearest
+	 matched record before it.  */
+      lin after = -1;
+      for (lin i = 0; i < n0; i++)
+	{
+	  lin j = match0[i];
+	  if (! (0 <= j && e0[i] == e1[j]))
+	    {
+	      print_record_header (i, j, -1, after);
+	      print_record ("<", DELETE_CONTEXT, &curr.file[0], i);
+	      if (0 <= j)
+		{
+		  fputs ("---\n", outfile);
+		  print_record (">", ADD_CONTEXT, &curr.file[1], j);
+		}
+	    }
+	  if (0 <= j)
+	    after = j;
+	}
+      after = -1;
+      for (lin j = 0; j < n1; j++)
+	if (match1[j] < 0)
+	  {
+	    print_record_header (-1, j, after, -1);
+	    print_record (">", ADD_CONTEXT, &curr.file[1], j);
+	  }
+	else
+	  after = match1[j];
+
+      finish_output ();
+    }
+
+  free (key.data);
+  free (match1);
+  free (match0);
+  free (next);
+  free (buckets);
+  free (keyoff);
+  free (keys.data);
+  for (int f = 0; f < 2; f++)
+    {
+      free (filevec[f].equivs);
+      free (filevec[f].linbuf + filevec[f].linbuf_base);
+    }
+
+  return changes;
+}
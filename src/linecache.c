@@ -0,0 +1,250 @@
+/* Cache line boundaries and hashes between runs of GNU DIFF.
+
+   Copyright (C) 2024 Free Software Foundation, Inc.
+
+   This file is part of GNU DIFF.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* A line cache (--line-cache=DIR) keeps, for each regular file that
+   diff has split into lines, the offset of each line and the hash of
+   each line's contents, so that a later run need not scan the file
+   again if it has not changed.  Hashes depend on options like
+   --ignore-case, on the locale and on the hash function itself, so
+   these are recorded too, and a cache entry made with different
+   settings is ignored.  Hashes are used only to find candidate
+   equivalence classes, which are still verified by comparing lines,
+   so a stale hash cannot make unequal lines compare equal.  Hashes
+   made by a different hash function could make equal lines seem to
+   differ, though, which is why its version is recorded.
+
+   The cache entry for a file is named after its device and inode
+   numbers.  It consists of a header, the signature of the settings,
+   padding to a multiple of the size of idx_t, the line offsets
+   and the line hashes.  All numbers use the native representation,
+   so the file can be read (or mapped) directly into memory.  */
+
+#include "diff.h"
+
+#include <cmpbuf.h>
+#include <filenamecat.h>
+#include <xalloc.h>
+
+#include <locale.h>
+
+/* The header of a cache entry.  */
+struct line_cache_header
+{
+  char magic[16];
+  uintmax_t dev;
+  uintmax_t ino;
+  intmax_t size;
+  struct timespec mtime;
+  struct timespec ctime;
+
+  /* Number of lines, and the length of the signature that follows.  */
+  idx_t nlines;
+  idx_t siglen;
+};
+
+static char const line_cache_magic[16] = "GNU diff lines2";
+
+/* The directory of cache entries, or null if there is no line cache.  */
+char const *line_cache_dir;
+
+/* The signature of the settings that hashes depend on.  */
+static char *signature;
+static idx_t siglen;
+
+/* When this run started.  */
+static struct timespec start_time;
+
+/* Use the directory DIR as the line cache.  Call this after the
+   options that affect hashing are set.  */
+
+void
+line_cache_init (char const *dir)
+{
+  line_cache_dir = dir;
+  timespec_get (&start_time, TIME_UTC);
+
+  char const *locale = setlocale (LC_CTYPE, nullptr);
+  if (!locale)
+    locale = "";
+  signature = xmalloc (sizeof "hash= case= space= cr= tab= mb= ctype="
+		       + 5 * INT_STRLEN_BOUND (intmax_t) + strlen (locale));
+  siglen = sprintf (signature,
+		    "hash=%d case=%d space=%d cr=%d tab=%jd mb=%d ctype=%s",
+		    LINE_HASH_VERSION, ignore_case, (int) ignore_white_space,
+		    strip_trailing_cr, tabsize, (int) MB_CUR_MAX, locale);
+}
+
+/* Return the name of the cache entry for the file with status *ST.  */
+
+static char *
+entry_name (struct stat const *st)
+{
+  char base[2 * INT_STRLEN_BOUND (uintmax_t) + 2];
+  sprintf (base, "%ju-%ju", (uintmax_t) st->st_dev, (uintmax_t) st->st_ino);
+  return file_name_concat (line_cache_dir, base, nullptr);
+}
+
+/* Return the offset of the line offsets within an entry.  */
+
+static idx_t
+offsets_offset (void)
+{
+  idx_t off = sizeof (struct line_cache_header) + siglen;
+  return off + (- off & (sizeof (idx_t) - 1));
+}
+
+/* Set *HEADER from the status *ST of a file with NLINES lines.  */
+
+static void
+set_header (struct line_cache_header *header, struct stat const *st,
+	    lin nlines)
+{
+  memset (header, 0, sizeof *header);
+  memcpy (header->magic, line_cache_magic, sizeof header->magic);
+  header->dev = st->st_dev;
+  header->ino = st->st_ino;
+  header->size = st->st_size;
+  header->mtime = get_stat_mtime (st);
+  header->ctime = get_stat_ctime (st);
+  header->nlines = nlines;
+  header->siglen = siglen;
+}
+
+/* If the cache has an entry for the file CURRENT, which has been read
+   into memory, set *TABLE to its line table and return true.
+   Otherwise return false.  */
+
+bool
+line_cache_load (struct file_data const *current, struct line_table *table)
+{
+  char *name = entry_name (&current->stat);
+  int fd = open (name, O_RDONLY | O_BINARY | O_CLOEXEC);
+  free (name);
+  if (fd < 0)
+    return false;
+
+  struct line_cache_header header, expected;
+  void *data = nullptr;
+  bool ok = false;
+  idx_t datasize, hashes_offset;
+  set_header (&expected, &current->stat, 0);
+  if (block_read (fd, (char *) &header, sizeof header) == sizeof header
+      && memcmp (header.magic, expected.magic, sizeof header.magic) == 0
+      && header.dev == expected.dev && header.ino == expected.ino
+      && header.size == expected.size
+      && timespec_cmp (header.mtime, expected.mtime) == 0
+      && timespec_cmp (header.ctime, expected.ctime) == 0
+      && header.siglen == siglen
+      && 0 <= header.nlines
+      && ! ckd_mul (&hashes_offset, header.nlines + 1, sizeof (idx_t))
+      && ! ckd_add (&hashes_offset, hashes_offset, offsets_offset ())
+      && ! ckd_mul (&datasize, header.nlines, sizeof (size_t))
+      && ! ckd_add (&datasize, datasize, hashes_offset))
+    {
+      data = ximalloc (datasize);
+      memcpy (data, &header, sizeof header);
+      idx_t rest = datasize - sizeof header;
+      ok = (block_read (fd, (char *) data + sizeof header, rest) == rest
+	    && memcmp ((char *) data + sizeof header, signature, siglen) == 0);
+    }
+  close (fd);
+
+  if (ok)
+    {
+      table->nlines = header.nlines;
+      table->offsets = (idx_t *) ((char *) data + offsets_offset ());
+      table->hashes = (size_t *) ((char *) data + hashes_offset);
+      table->data = data;
+
+      /* Check that the lines match the file's contents, in case the
+	 file changed without its status changing.  This is much faster
+	 than hashing the lines.  */
+      char const *buf = (char const *) current->buffer;
+      idx_t *offsets = table->offsets;
+      ok = (offsets[0] == 0
+	    && offsets[header.nlines] == current->buffered);
+      for (lin i = 0; ok && i < header.nlines; i++)
+	ok = (offsets[i] < offsets[i + 1]
+	      && offsets[i + 1] <= current->buffered
+	      && (memchr (buf + offsets[i], '\n', offsets[i + 1] - offsets[i])
+		  == buf + offsets[i + 1] - 1));
+    }
+
+  if (!ok)
+    free (data);
+  return ok;
+}
+
+/* Save the line table TABLE of the file CURRENT in the cache.  */
+
+void
+line_cache_save (struct file_data const *current,
+		 struct line_table const *table)
+{
+  /* Do not trust a status change time that is not before this run
+     started, as the file might change again without its status
+     changing if timestamps are coarse.  */
+  if (get_stat_ctime (&current->stat).tv_sec < start_time.tv_sec)
+    {
+      char *name = entry_name (&current->stat);
+      idx_t namelen = strlen (name);
+      char *tmpname = ximalloc (namelen + sizeof ".XXXXXX");
+      strcpy (stpcpy (tmpname, name), ".XXXXXX");
+
+      struct line_cache_header header;
+      set_header (&header, &current->stat, table->nlines);
+      static char const padding[sizeof (idx_t)];
+      idx_t padlen = offsets_offset () - sizeof header - siglen;
+
+      if (mkdir (line_cache_dir, S_IRWXU | S_IRWXG | S_IRWXO) != 0
+	  && errno != EEXIST)
+	perror_with_name (line_cache_dir);
+      else
+	{
+	  /* Use a unique temporary name, as other runs of diff can be
+	     saving the same entry at the same time.  */
+	  int fd = mkstemp (tmpname);
+	  FILE *stream = fd < 0 ? nullptr : fdopen (fd, "wb");
+	  bool ok = false;
+	  if (!stream && 0 <= fd)
+	    close (fd);
+	  if (stream)
+	    {
+	      fwrite (&header, sizeof header, 1, stream);
+	      fwrite (signature, 1, siglen, stream);
+	      fwrite (padding, 1, padlen, stream);
+	      fwrite (table->offsets, sizeof *table->offsets,
+		      table->nlines + 1, stream);
+	      fwrite (table->hashes, sizeof *table->hashes, table->nlines,
+		      stream);
+	      ok = (!ferror (stream)) & (fclose (stream) == 0);
+	      ok = ok && rename (tmpname, name) == 0;
+	    }
+	  if (!ok)
+	    {
+	      perror_with_name (tmpname);
+	      if (0 <= fd)
+		unlink (tmpname);
+	    }
+	}
+
+      free (tmpname);
+      free (name);
+    }
+}
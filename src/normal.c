@@ -62,7 +62,7 @@ print_normal_hunk (struct change *hunk)
           set_color_context (DELETE_CONTEXT);
 	  print_1_line_nl ("<", &curr.file[0].linbuf[i], true);
           set_color_context (RESET_CONTEXT);
-	  if (curr.file[0].linbuf[i + 1][-1] == '\n')
+	  if (line_is_complete (curr.file[0].linbuf[i + 1]))
             putc ('\n', outfile);
         }
     }
@@ -78,7 +78,7 @@ print_normal_hunk (struct change *hunk)
           set_color_context (ADD_CONTEXT);
 	  print_1_line_nl (">", &curr.file[1].linbuf[i], true);
           set_color_context (RESET_CONTEXT);
-	  if (curr.file[1].linbuf[i + 1][-1] == '\n')
+	  if (line_is_complete (curr.file[1].linbuf[i + 1]))
             putc ('\n', outfile);
         }
     }
@@ -261,13 +261,9 @@ perror_fatal (char const *msg)
 }
 
 static void
-check_child_status (int werrno, int wstatus, int max_ok_status,
-                    char const *subsidiary_program)
+report_child_status (int werrno, int status, int max_ok_status,
+                     char const *subsidiary_program)
 {
-  int status = (! werrno && WIFEXITED (wstatus)
-                ? WEXITSTATUS (wstatus)
-                : INT_MAX);
-
   if (max_ok_status < status)
     {
       error (0, werrno,
@@ -283,6 +279,17 @@ check_child_status (int werrno, int wstatus, int max_ok_status,
     }
 }
 
+static void
+check_child_status (int werrno, int wstatus, int max_ok_status,
+                    char const *subsidiary_program)
+{
+  report_child_status (werrno,
+                       (! werrno && WIFEXITED (wstatus)
+                        ? WEXITSTATUS (wstatus)
+                        : INT_MAX),
+                       max_ok_status, subsidiary_program);
+}
+
 static FILE *
 ck_fopen (char const *fname, char const *type)
 {
@@ -617,28 +624,22 @@ main (int argc, char *argv[])
         if (pipe (diff_fds) != 0)
           perror_fatal ("pipe");
 
-        diffpid = fork ();
+        /* The child ignores SIGINT in case the user interrupts the editor,
+           so ignore SIGINT while spawning it.
+           The child does not ignore SIGPIPE, even if the parent does.  */
+        sigset_t sigdefault;
+        sigemptyset (&sigdefault);
+        sigaddset (&sigdefault, SIGPIPE);
+        signal_handler (SIGINT, SIG_IGN);
+        diffpid = spawn_program (diffargv[0], diffargv, true,
+                                 diff_fds[1], STDOUT_FILENO, diff_fds[0],
+                                 &sigdefault);
+        int spawn_errno = errno;
+        if (initial_handler (handler_index_of_SIGINT) != SIG_IGN)
+          signal_handler (SIGINT, catchsig);
         if (diffpid < 0)
-          perror_fatal ("fork");
-        if (! diffpid)
-          {
-            /* Alter the child's SIGINT and SIGPIPE handlers;
-               this may munge the parent.
-               The child ignores SIGINT in case the user interrupts the editor.
-               The child does not ignore SIGPIPE, even if the parent does.  */
-            if (initial_handler (handler_index_of_SIGINT) != SIG_IGN)
-              signal_handler (SIGINT, SIG_IGN);
-            signal_handler (SIGPIPE, SIG_DFL);
-            close (diff_fds[0]);
-            if (diff_fds[1] != STDOUT_FILENO)
-              {
-                dup2 (diff_fds[1], STDOUT_FILENO);
-                close (diff_fds[1]);
-              }
-
-            execvp (diffargv[0], (char **) diffargv);
-            _exit (errno == ENOENT ? 127 : 126);
-          }
+          report_child_status (0, spawn_failure_status (spawn_errno),
+                               EXIT_FAILURE, diffargv[0]);
 
         close (diff_fds[1]);
         diffout = fdopen (diff_fds[0], "r");
@@ -1009,15 +1010,12 @@ edit (struct line_filter *left, char const *lname, lin lline, lin llen,
             werrno = errno;
           free (command);
 #else
-          pid_t pid = fork ();
-          if (pid == 0)
-            {
-              execvp (editor_program, argv);
-              _exit (errno == ENOENT ? 127 : 126);
-            }
-
+          pid_t pid = spawn_program (editor_program,
+                                     (char const *const *) argv, true,
+                                     -1, -1, -1, nullptr);
           if (pid < 0)
-            perror_fatal ("fork");
+            report_child_status (0, spawn_failure_status (errno),
+                                 EXIT_SUCCESS, editor_program);
 
           while (waitpid (pid, &wstatus, 0) < 0)
             if (errno == EINTR)
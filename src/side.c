@@ -233,21 +233,21 @@ print_1sdiff_line (char const *const *left, char sep,
 
   if (left)
     {
-      put_newline |= left[1][-1] == '\n';
+      put_newline |= line_is_complete (left[1]);
       col = print_half_line (left, 0, hw);
     }
 
   if (sep != ' ')
     {
       col = tab_from_to (col, (hw + c2o - 1) >> 1) + 1;
-      if (sep == '|' && put_newline != (right[1][-1] == '\n'))
+      if (sep == '|' && put_newline != line_is_complete (right[1]))
         sep = put_newline ? '/' : '\\';
       putc (sep, out);
     }
 
   if (right)
     {
-      put_newline |= right[1][-1] == '\n';
+      put_newline |= line_is_complete (right[1]);
       if (**right != '\n')
         {
           col = tab_from_to (col, c2o);
@@ -21,6 +21,8 @@
 #define SYSTEM_INLINE _GL_EXTERN_INLINE
 #include "system.h"
 
+#include <spawn.h>
+
 /* Do struct stat *S, *T describe the same file?  */
 bool
 same_file (struct stat const *s, struct stat const *t)
@@ -161,3 +163,75 @@ stat_size (struct stat const *s)
 
   return size;
 }
+
+/* Start a child process that runs PROGRAM with arguments ARGV,
+   searching PATH for PROGRAM if SEARCH.  If FD is nonnegative, it is
+   one end of a pipe whose other end is OTHER_FD; the child gets FD as
+   its file descriptor CHILD_FD, and gets neither FD nor OTHER_FD
+   under their own numbers.  If SIGDEFAULT is nonnull, the child uses
+   the default actions for the signals in *SIGDEFAULT.
+
+   Unlike fork, posix_spawn need not copy the parent's page tables,
+   which matters when the parent is large.  Return the child's process
+   ID if successful.  Otherwise, return -1 and set errno; the caller
+   should then act as if the child exited with status
+   spawn_failure_status (errno), as a failure to run PROGRAM may be
+   reported either way.  */
+
+pid_t
+spawn_program (char const *program, char const *const *argv, bool search,
+	       int fd, int child_fd, int other_fd, sigset_t const *sigdefault)
+{
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  int err = posix_spawn_file_actions_init (&actions);
+  if (err)
+    {
+      errno = err;
+      return -1;
+    }
+  err = posix_spawnattr_init (&attr);
+  if (err)
+    {
+      posix_spawn_file_actions_destroy (&actions);
+      errno = err;
+      return -1;
+    }
+
+  if (0 <= fd)
+    {
+      err = posix_spawn_file_actions_addclose (&actions, other_fd);
+      if (!err && fd != child_fd)
+	{
+	  err = posix_spawn_file_actions_adddup2 (&actions, fd, child_fd);
+	  if (!err)
+	    err = posix_spawn_file_actions_addclose (&actions, fd);
+	}
+    }
+  if (!err && sigdefault)
+    {
+      err = posix_spawnattr_setsigdefault (&attr, sigdefault);
+      if (!err)
+	err = posix_spawnattr_setflags (&attr, POSIX_SPAWN_SETSIGDEF);
+    }
+
+  pid_t pid;
+  if (!err)
+    {
+      /* The cast is needed for portability to hosts whose
+	 prototypes lack const.  */
+      char *const *args = (char *const *) argv;
+      err = (search
+	     ? posix_spawnp (&pid, program, &actions, &attr, args, environ)
+	     : posix_spawn (&pid, program, &actions, &attr, args, environ));
+    }
+  posix_spawnattr_destroy (&attr);
+  posix_spawn_file_actions_destroy (&actions);
+
+  if (err)
+    {
+      errno = err;
+      return -1;
+    }
+  return pid;
+}
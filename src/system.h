@@ -148,9 +148,18 @@ SYSTEM_INLINE int floor_log2 (idx_t n)
   return w - 1;
 }
 
+/* Return the exit status of a child that could not run a program
+   because of error ERR, using the shell's conventions.  */
+SYSTEM_INLINE int spawn_failure_status (int err)
+{
+  return err == ENOENT ? 127 : 126;
+}
+
 _GL_INLINE_HEADER_END
 
 extern bool same_file (struct stat const *, struct stat const *)
   ATTRIBUTE_PURE;
 extern off_t stat_size (struct stat const *)
   ATTRIBUTE_PURE;
+extern pid_t spawn_program (char const *, char const *const *, bool,
+			    int, int, int, sigset_t const *);
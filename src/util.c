@@ -33,6 +33,10 @@
 #include <stdarg.h>
 #include <signal.h>
 
+#if HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
 /* Use SA_NOCLDSTOP as a proxy for whether the sigaction machinery is
    present.  */
 #ifndef SA_NOCLDSTOP
@@ -183,6 +187,8 @@ print_message_queue (void)
       free (m);
       m = next;
     }
+  msg_chain = nullptr;
+  msg_chain_end = &msg_chain;
 }
 
 /* Signal handling, needed for restoring default colors.  */
@@ -786,10 +792,52 @@ setup_output (char const *name0, char const *name1, bool recursive)
   outfile = nullptr;
 }
 
+/* Let the output stream STREAM, whose consumer might be slow, buffer
+   more output before writing stalls.  Call this before any output to
+   STREAM.  Terminals are left alone, as their users want to see
+   output promptly and they are usually fast enough.  Otherwise use a
+   larger stdio buffer, so that output needs fewer system calls.  If
+   STREAM is a pipe, also enlarge the pipe where the system allows, so
+   that diff can run ahead of a reader like a pager, a compressor or
+   ssh rather than waiting on every write.  Failure to enlarge
+   anything is harmless.  */
+
+void
+buffer_output (FILE *stream)
+{
+  enum { OUTPUT_BUFSIZE = 128 * 1024, PIPE_BUFSIZE = 1024 * 1024 };
+  int fd = fileno (stream);
+  struct stat st;
+  if (fd < 0 || fstat (fd, &st) != 0 || isatty (fd))
+    return;
+  setvbuf (stream, nullptr, _IOFBF, OUTPUT_BUFSIZE);
+#ifdef F_SETPIPE_SZ
+  if (S_ISFIFO (st.st_mode) && fcntl (fd, F_GETPIPE_SZ) < PIPE_BUFSIZE)
+    fcntl (fd, F_SETPIPE_SZ, PIPE_BUFSIZE);
+#endif
+}
+
 #if HAVE_WORKING_FORK
 static pid_t pr_pid;
 #endif
 
+/* Report a failure of the subsidiary 'pr' that exited with STATUS,
+   or INT_MAX if it did not exit normally, and errno WERRNO.  */
+
+static void
+check_pr_status (int werrno, int status)
+{
+  if (status)
+    error (EXIT_TROUBLE, werrno,
+	   _(status == 126
+	     ? "subsidiary program %s could not be invoked"
+	     : status == 127
+	     ? "subsidiary program %s not found"
+	     : status == INT_MAX
+	     ? "subsidiary program %s failed"
+	     : "subsidiary program %s failed (exit status %d)"),
+	   quote (pr_program), status);
+}
 
 void
 begin_output (void)
@@ -832,29 +880,17 @@ begin_output (void)
       if (pipe (pipes) != 0)
 	pfatal_with_name ("pipe");
 
-      pr_pid = fork ();
+      pr_pid = spawn_program (pr_program, argv, false,
+			      pipes[0], STDIN_FILENO, pipes[1], nullptr);
       if (pr_pid < 0)
-	pfatal_with_name ("fork");
-
-      if (pr_pid == 0)
-	{
-	  close (pipes[1]);
-	  if (pipes[0] != STDIN_FILENO)
-	    {
-	      if (dup2 (pipes[0], STDIN_FILENO) < 0)
-		pfatal_with_name ("dup2");
-	      close (pipes[0]);
-	    }
-
-	  execv (pr_program, (char **) argv);
-	  _exit (errno == ENOENT ? 127 : 126);
-	}
+	check_pr_status (0, spawn_failure_status (errno));
       else
 	{
 	  close (pipes[0]);
 	  outfile = fdopen (pipes[1], "w");
 	  if (!outfile)
 	    pfatal_with_name ("fdopen");
+	  buffer_output (outfile);
 	  check_color_output (true);
 	}
 #else
@@ -911,19 +947,9 @@ finish_output (void)
       if (waitpid (pr_pid, &wstatus, 0) < 0)
         pfatal_with_name ("waitpid");
 #endif
-      int status = (! werrno && WIFEXITED (wstatus)
-		    ? WEXITSTATUS (wstatus)
-		    : INT_MAX);
-      if (status)
-        error (EXIT_TROUBLE, werrno,
-               _(status == 126
-		 ? "subsidiary program %s could not be invoked"
-                 : status == 127
-		 ? "subsidiary program %s not found"
-                 : status == INT_MAX
-		 ? "subsidiary program %s failed"
-		 : "subsidiary program %s failed (exit status %d)"),
-	       quote (pr_program), status);
+      check_pr_status (werrno, (! werrno && WIFEXITED (wstatus)
+				? WEXITSTATUS (wstatus)
+				: INT_MAX));
     }
 
   outfile = nullptr;
@@ -1027,7 +1053,13 @@ print_1_line_nl (char const *line_flag, char const *const *line, bool skip_nl)
 
   output_1_line (base, limit - (skip_nl && limit[-1] == '\n'), flag_format, line_flag);
 
-  if ((!line_flag || line_flag[0]) && limit[-1] != '\n')
+  if (limit[-1] != '\n' && line_is_complete (limit))
+    {
+      /* This is a piece of a line split by --split-lines.  */
+      if (!skip_nl)
+	putc ('\n', out);
+    }
+  else if ((!line_flag || line_flag[0]) && limit[-1] != '\n')
     {
       set_color_context (RESET_CONTEXT);
       fprintf (out, "\n\\ %s\n", _("No newline at end of file"));
@@ -1047,6 +1079,15 @@ output_1_line (char const *base, char const *limit, char const *flag_format,
   if (!expand_tabs)
     {
       idx_t left = limit - base;
+
+      /* If no signals are caught, there is no need to process them
+	 between chunks, so write even a very long line all at once.  */
+      if (!some_signals_caught)
+	{
+	  fwrite (base, sizeof (char), left, outfile);
+	  return;
+	}
+
       while (left)
         {
           idx_t to_write = MIN (left, MAX_CHUNK);
@@ -1337,6 +1378,28 @@ analyze_hunk (struct change *hunk,
   return (show_from ? OLD : UNCHANGED) | (show_to ? NEW : UNCHANGED);
 }
 
+/* Advise the system that the SIZE bytes at P, typically a block just
+   allocated or an array just grown by xpalloc or xirealloc, are
+   accessed often enough that they are worth backing with huge pages.
+   Any contents of the block are preserved.  Only the whole huge pages
+   within the block are advised; smaller blocks are left alone, as
+   are systems where transparent huge pages are disabled.  */
+
+void
+advise_huge_pages (void *p, idx_t size)
+{
+#if HAVE_SYS_MMAN_H && defined MADV_HUGEPAGE
+  enum { HUGE_PAGE_SIZE = 2 * 1024 * 1024 };
+  if (2 * HUGE_PAGE_SIZE <= size)
+    {
+      uintptr_t lo = ((uintptr_t) p + HUGE_PAGE_SIZE - 1) & -HUGE_PAGE_SIZE;
+      uintptr_t hi = ((uintptr_t) p + size) & -HUGE_PAGE_SIZE;
+      if (lo < hi)
+	madvise ((void *) lo, hi - lo, MADV_HUGEPAGE);
+    }
+#endif
+}
+
 #ifdef DEBUG
 void
 debug_script (struct change *sp)
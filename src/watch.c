@@ -0,0 +1,393 @@
+/* Compare files again as they change.  Used for GNU DIFF.
+
+   Copyright (C) 2024 Free Software Foundation, Inc.
+
+   This file is part of GNU DIFF.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "diff.h"
+
+#include <dirname.h>
+#include <exclude.h>
+#include <filenamecat.h>
+#include <xalloc.h>
+
+#if HAVE_SYS_INOTIFY_H
+
+# include <poll.h>
+# include <sys/inotify.h>
+
+/* Events that can change the result of a comparison.  */
+enum
+{
+  WATCH_MASK = (IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+		| IN_DELETE_SELF | IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM
+		| IN_MOVED_TO | IN_DONT_FOLLOW | IN_ONLYDIR)
+};
+
+/* How long to wait, in milliseconds, for a burst of events to settle
+   before comparing again.  */
+enum { SETTLE_TIME = 100 };
+
+/* A watched directory.  */
+struct watch
+{
+  /* Which operand the directory belongs to, or -1 if the slot is unused.  */
+  int side;
+
+  /* The directory's name relative to the operand, or "" for the
+     operand itself.  If both operands are not directories, this is
+     the name of the watched directory instead.  */
+  char *dir;
+
+  /* True if events for all files in the directory are of interest.
+     Otherwise, only events for the nonnull names in ONLY are;
+     ONLY[F] is the last component of operand F.  */
+  bool all;
+  char const *only[2];
+};
+
+/* The inotify file descriptor.  */
+static int inotify_fd;
+
+/* The watches, indexed by watch descriptor.  */
+static struct watch *watches;
+static idx_t watches_alloc;
+
+/* The two operands.  */
+static char const *operand[2];
+
+/* True if both operands are directories, so that individual files
+   within them can be compared again.  Otherwise, any change causes
+   the operands to be compared again.  */
+static bool dir_mode;
+
+/* True if subdirectories are compared too.  */
+static bool recursive;
+
+/* The names, relative to the operands, that need comparing again.
+   The empty name stands for the operands themselves.  */
+static char **affected;
+static idx_t naffected;
+static idx_t affected_alloc;
+
+static enum detype const de_unknowns[] = { DE_UNKNOWN, DE_UNKNOWN };
+
+/* Note that the file NAME, relative to the operands, needs comparing
+   again.  Take ownership of NAME.  */
+
+static void
+note_affected (char *name)
+{
+  if (naffected == affected_alloc)
+    affected = xpalloc (affected, &affected_alloc, 1, -1, sizeof *affected);
+  affected[naffected++] = name;
+}
+
+/* Return the name of the file whose name relative to operand SIDE is
+   REL.  */
+
+static char *
+operand_file_name (int side, char const *rel)
+{
+  return (*rel
+	  ? file_name_concat (operand[side], rel, nullptr)
+	  : xstrdup (operand[side]));
+}
+
+/* Return true if FILE names a directory that should be descended into.  */
+
+static bool
+is_dir (char const *file)
+{
+  struct stat st;
+  return (fstatat (AT_FDCWD, file, &st,
+		   no_dereference_symlinks ? AT_SYMLINK_NOFOLLOW : 0) == 0
+	  && S_ISDIR (st.st_mode));
+}
+
+/* Watch the directory FILE, which is REL relative to operand SIDE,
+   reporting events only for ONLY if ONLY is nonnull.  If comparing
+   recursively, also watch its subdirectories.  When both operands
+   are not directories, the same directory can be watched on behalf
+   of both, e.g., if both operands are in the working directory.  */
+
+static void
+add_watch (int side, char const *file, char const *rel, char const *only)
+{
+  int wd = inotify_add_watch (inotify_fd, file, WATCH_MASK);
+  if (wd < 0)
+    {
+      if (errno != ENOENT && errno != ENOTDIR)
+	perror_with_name (file);
+      return;
+    }
+
+  if (watches_alloc <= wd)
+    {
+      idx_t old_alloc = watches_alloc;
+      watches = xpalloc (watches, &watches_alloc, wd + 1 - watches_alloc, -1,
+			 sizeof *watches);
+      for (idx_t i = old_alloc; i < watches_alloc; i++)
+	watches[i].side = -1;
+    }
+
+  struct watch *w = &watches[wd];
+  if (0 <= w->side)
+    {
+      /* A directory reached twice, e.g., via a symbolic link, keeps its
+	 first watch and is not descended into again.  */
+      if (!dir_mode)
+	{
+	  w->all |= !only;
+	  w->only[side] = only;
+	}
+      return;
+    }
+  w->side = side;
+  w->dir = xstrdup (rel);
+  w->all = !only;
+  w->only[side] = only;
+  w->only[!side] = nullptr;
+
+  if (! (dir_mode && recursive))
+    return;
+
+  DIR *reading = opendir (file);
+  if (!reading)
+    {
+      perror_with_name (file);
+      return;
+    }
+  for (struct dirent *next; (next = readdir (reading)); )
+    {
+      char const *d_name = next->d_name;
+      if ((d_name[0] == '.'
+	   && (d_name[1] == 0 || (d_name[1] == '.' && d_name[2] == 0)))
+	  || excluded_file_name (excluded, d_name))
+	continue;
+      char *subfile = file_name_concat (file, d_name, nullptr);
+      if (is_dir (subfile))
+	{
+	  char *subrel = *rel ? file_name_concat (rel, d_name, nullptr)
+			      : xstrdup (d_name);
+	  add_watch (side, subfile, subrel, nullptr);
+	  free (subrel);
+	}
+      free (subfile);
+    }
+  closedir (reading);
+}
+
+/* Read the pending events from the inotify file descriptor,
+   noting the affected files.  */
+
+static void
+read_events (void)
+{
+  alignas (struct inotify_event) char buf[64 * 1024];
+  ssize_t nread = read (inotify_fd, buf, sizeof buf);
+  if (nread < 0)
+    {
+      if (errno == EINTR)
+	return;
+      pfatal_with_name ("inotify");
+    }
+
+  for (char *p = buf; p < buf + nread; )
+    {
+      struct inotify_event const *ev = (struct inotify_event const *) p;
+      p += sizeof *ev + ev->len;
+
+      if (ev->mask & IN_Q_OVERFLOW)
+	{
+	  /* Events were lost, so compare everything again.  */
+	  note_affected (xstrdup (""));
+	  continue;
+	}
+      if (! (0 <= ev->wd && ev->wd < watches_alloc
+	     && 0 <= watches[ev->wd].side))
+	continue;
+
+      struct watch *w = &watches[ev->wd];
+      if (ev->mask & IN_IGNORED)
+	{
+	  free (w->dir);
+	  w->side = -1;
+	  continue;
+	}
+
+      char const *name = ev->len ? ev->name : "";
+      if (! (w->all
+	     || (w->only[0] && STREQ (name, w->only[0]))
+	     || (w->only[1] && STREQ (name, w->only[1]))))
+	continue;
+      if (!dir_mode)
+	{
+	  note_affected (xstrdup (""));
+	  continue;
+	}
+      if (*name && excluded_file_name (excluded, name))
+	continue;
+
+      char *rel = (!*name ? xstrdup (w->dir)
+		   : !*w->dir ? xstrdup (name)
+		   : file_name_concat (w->dir, name, nullptr));
+      if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) && (ev->mask & IN_ISDIR)
+	  && recursive)
+	{
+	  char *file = operand_file_name (w->side, rel);
+	  add_watch (w->side, file, rel, nullptr);
+	  free (file);
+	}
+      note_affected (rel);
+    }
+}
+
+static int
+compare_affected (void const *a, void const *b)
+{
+  char *const *p = a;
+  char *const *q = b;
+  return strcmp (*p, *q);
+}
+
+/* Compare again the file REL, relative to the operands.  */
+
+static void
+compare_again (char const *rel)
+{
+  if (!*rel)
+    {
+      compare_files (&noparent, de_unknowns, operand[0], operand[1]);
+      return;
+    }
+
+  /* Compare REL as an entry of its parent directories, so that files
+     now present on only one side are reported as such.  The parent
+     directories must both exist; otherwise, the nearest ancestor that
+     exists on only one side is reported instead.  */
+  char *dir = dir_name (rel);
+  struct comparison parent = { .parent = &noparent };
+  bool exists[2];
+  for (int f = 0; f < 2; f++)
+    {
+      char *name = operand_file_name (f, *dir == '.' && !dir[1] ? "" : dir);
+      parent.file[f].name = name;
+      parent.file[f].desc = AT_FDCWD;
+      if (stat (name, &parent.file[f].stat) != 0
+	  || !S_ISDIR (parent.file[f].stat.st_mode))
+	exists[f] = false;
+      else
+	{
+	  char *file = operand_file_name (f, rel);
+	  struct stat st;
+	  exists[f] = fstatat (AT_FDCWD, file, &st, AT_SYMLINK_NOFOLLOW) == 0;
+	  free (file);
+	  continue;
+	}
+
+      /* A parent directory is missing.  */
+      free (name);
+      if (f == 1)
+	free ((char *) parent.file[0].name);
+      free (dir);
+      return;
+    }
+
+  if (exists[0] | exists[1])
+    {
+      char const *base = last_component (rel);
+      compare_files (&parent, de_unknowns,
+		     exists[0] ? base : nullptr, exists[1] ? base : nullptr);
+    }
+
+  for (int f = 0; f < 2; f++)
+    free ((char *) parent.file[f].name);
+  free (dir);
+}
+
+/* After comparing the operands FILE0 and FILE1, watch them for
+   changes and compare again whatever changes, forever.  Watch
+   subdirectories too if RECURSE.  */
+
+void
+watch_files (char const *file0, char const *file1, bool recurse)
+{
+  operand[0] = file0;
+  operand[1] = file1;
+  recursive = recurse;
+  dir_mode = is_dir (file0) && is_dir (file1);
+
+  inotify_fd = inotify_init1 (IN_CLOEXEC);
+  if (inotify_fd < 0)
+    pfatal_with_name ("inotify");
+
+  for (int f = 0; f < 2; f++)
+    {
+      if (dir_mode || is_dir (operand[f]))
+	add_watch (f, operand[f], "", nullptr);
+      if (!dir_mode)
+	{
+	  /* Watch the parent directory too, as editors often replace
+	     a file rather than modify it in place.  */
+	  char *dir = dir_name (operand[f]);
+	  add_watch (f, dir, dir, last_component (operand[f]));
+	  free (dir);
+	}
+    }
+
+  while (true)
+    {
+      print_message_queue ();
+      if (fflush (stdout) != 0)
+	pfatal_with_name (_("standard output"));
+
+      struct pollfd pfd = { .fd = inotify_fd, .events = POLLIN };
+      if (poll (&pfd, 1, -1) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  pfatal_with_name ("poll");
+	}
+
+      /* Gather a burst of events, so that a file that is being
+	 written is compared once, after it settles.  */
+      do
+	read_events ();
+      while (0 < poll (&pfd, 1, SETTLE_TIME));
+
+      qsort (affected, naffected, sizeof *affected, compare_affected);
+      for (idx_t i = 0; i < naffected; i++)
+	{
+	  if (! (i && STREQ (affected[i - 1], affected[i])))
+	    compare_again (affected[i]);
+	}
+      for (idx_t i = 0; i < naffected; i++)
+	free (affected[i]);
+      naffected = 0;
+    }
+}
+
+#else
+
+void
+watch_files (MAYBE_UNUSED char const *file0, MAYBE_UNUSED char const *file1,
+	     MAYBE_UNUSED bool recurse)
+{
+  fatal ("--watch is not supported on this system");
+}
+
+#endif